@@ -0,0 +1,188 @@
+/**
+ * @file bitImage.h
+ * @brief Cabecera para la clase BitImage, imágenes binarias de un bit por píxel
+ */
+
+#ifndef _BIT_IMAGE_H_
+#define _BIT_IMAGE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <image.h>
+
+/**
+  @brief Imagen binaria empaquetada, de un bit por píxel.
+
+  Ocupa la octava parte que una Image con los mismos píxeles a 0 y 255, así que es la salida
+  natural de las binarizaciones (ver Image::ThresholdBits() y Image::AdaptiveThresholdBits()).
+  Las operaciones lógicas, el recuento de píxeles y los desplazamientos trabajan con palabras
+  enteras: 64 píxeles por instrucción.
+
+  Cada fila ocupa get_words() palabras de 64 bits: el píxel (i, j) es el bit j % 64 (contando
+  desde el menos significativo) de la palabra j / 64 de la fila i. Los bits de la última palabra
+  que quedan a la derecha de la imagen están siempre a 0.
+
+  Se lee y se escribe en formato PBM binario (P4). Como ToImage() convierte los píxeles a 1 en
+  blanco y en PBM el 1 es negro, al guardar se invierten los bits: la imagen se ve igual en un
+  visor que convertida a grises.
+**/
+class BitImage {
+public:
+
+    /**
+      * @brief Constructor por defecto: imagen vacía.
+      */
+    BitImage ();
+
+    /**
+      * @brief Constructor de una imagen con todos los píxeles a @a value.
+      * @param nrows número de filas.
+      * @param ncols número de columnas.
+      * @param value valor inicial de los píxeles.
+      */
+    BitImage (int nrows, int ncols, bool value = false);
+
+    /**
+      * @brief Constructor a partir de una imagen de grises, equivalente a image.ThresholdBits(t).
+      * @param image imagen a binarizar.
+      * @param t umbral: los píxeles mayores que @a t quedan a 1.
+      */
+    explicit BitImage (const Image & image, byte t = 127);
+
+    int get_rows () const { return rows; }
+
+    int get_cols () const { return cols; }
+
+    /**
+      * @brief Palabras de 64 bits que ocupa cada fila.
+      */
+    int get_words () const { return words; }
+
+    bool Empty () const { return rows == 0 || cols == 0; }
+
+    /**
+      * @brief Valor del píxel (i, j).
+      * @pre 0 <= i < get_rows() y 0 <= j < get_cols()
+      */
+    bool get_bit (int i, int j) const {
+        return (bits[(size_t)i * words + j / 64] >> (j % 64)) & 1;
+    }
+
+    /**
+      * @brief Asigna el valor del píxel (i, j).
+      * @pre 0 <= i < get_rows() y 0 <= j < get_cols()
+      */
+    void set_bit (int i, int j, bool value) {
+        uint64_t & w = bits[(size_t)i * words + j / 64];
+        uint64_t mask = (uint64_t)1 << (j % 64);
+        w = value ? (w | mask) : (w & ~mask);
+    }
+
+    /**
+      * @brief Palabras de la fila @a i.
+      *
+      * Quien escriba en ellas debe dejar a 0 los bits que sobran de la última.
+      * @pre 0 <= i < get_rows()
+      */
+    uint64_t * get_row (int i) { return bits.data() + (size_t)i * words; }
+
+    const uint64_t * get_row (int i) const { return bits.data() + (size_t)i * words; }
+
+    /**
+      * @brief Convierte la imagen en una imagen de grises.
+      * @param off valor de los píxeles a 0.
+      * @param on valor de los píxeles a 1.
+      * @return Devuelve una Image de las mismas dimensiones.
+      */
+    Image ToImage (byte off = 0, byte on = 255) const;
+
+    /**
+      * @brief Carga una imagen PBM binaria (P4).
+      * @param file_path fichero a leer.
+      * @return si se pudo leer. Si falla la imagen queda vacía.
+      */
+    bool Load (const char * file_path);
+
+    /**
+      * @brief Guarda la imagen en formato PBM binario (P4).
+      * @param file_path fichero a escribir.
+      * @return si se pudo escribir.
+      */
+    bool Save (const char * file_path) const;
+
+    /**
+      * @brief Número de píxeles a 1 (el área de la máscara).
+      */
+    long long Count () const;
+
+    /**
+      * @brief Invierte todos los píxeles.
+      * @post La imagen que llama la funcion es modificada.
+      */
+    void Invert ();
+
+    /**
+      * @brief Intersección píxel a píxel con otra imagen.
+      * @pre @a other tiene las mismas dimensiones.
+      */
+    BitImage & operator&= (const BitImage & other);
+
+    /**
+      * @brief Unión píxel a píxel con otra imagen.
+      * @pre @a other tiene las mismas dimensiones.
+      */
+    BitImage & operator|= (const BitImage & other);
+
+    /**
+      * @brief Diferencia simétrica píxel a píxel con otra imagen.
+      * @pre @a other tiene las mismas dimensiones.
+      */
+    BitImage & operator^= (const BitImage & other);
+
+    /**
+      * @brief Desplaza la imagen.
+      * @param dy filas hacia abajo (hacia arriba si es negativo).
+      * @param dx columnas hacia la derecha (hacia la izquierda si es negativo).
+      * @param fill valor de los píxeles que quedan al descubierto.
+      * @return Devuelve una imagen de las mismas dimensiones cuyo píxel (i, j) es el (i - dy, j - dx).
+      */
+    BitImage Shift (int dy, int dx, bool fill = false) const;
+
+    /**
+      * @brief Erosión con un rectángulo, como Image::Erode() sobre la imagen a 0 y 255.
+      * @pre height > 0 y width > 0
+      */
+    BitImage Erode (int height, int width) const;
+
+    /**
+      * @brief Dilatación con un rectángulo, como Image::Dilate() sobre la imagen a 0 y 255.
+      * @pre height > 0 y width > 0
+      */
+    BitImage Dilate (int height, int width) const;
+
+private:
+
+    int rows, cols, words;
+    std::vector<uint64_t> bits;
+
+    // Pone a 0 los bits que sobran de la última palabra de cada fila
+    void ClearPadding ();
+};
+
+/**
+  * @brief Intersección de dos imágenes de las mismas dimensiones.
+  */
+inline BitImage operator& (BitImage a, const BitImage & b) { return a &= b; }
+
+/**
+  * @brief Unión de dos imágenes de las mismas dimensiones.
+  */
+inline BitImage operator| (BitImage a, const BitImage & b) { return a |= b; }
+
+/**
+  * @brief Diferencia simétrica de dos imágenes de las mismas dimensiones.
+  */
+inline BitImage operator^ (BitImage a, const BitImage & b) { return a ^= b; }
+
+#endif // _BIT_IMAGE_H_
@@ -0,0 +1,149 @@
+/**
+ * @file diskCache.h
+ * @brief Cabecera para la caché en disco de resultados de operaciones sobre imágenes
+ */
+
+#ifndef _DISK_CACHE_H_
+#define _DISK_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <image.h>
+#include <fileIO.h>
+
+/**
+  * @brief Hash rápido no criptográfico de un bloque de bytes (algoritmo XXH64).
+  * @param data bytes a resumir.
+  * @param len número de bytes.
+  * @param seed semilla; semillas distintas dan hashes independientes.
+  * @return hash de 64 bits.
+  */
+uint64_t HashBytes (const void * data, size_t len, uint64_t seed = 0);
+
+/**
+  @brief Caché en disco de resultados, direccionada por contenido.
+
+  La clave de un resultado es un hash del contenido del fichero de entrada, leído proyectándolo
+  en memoria, junto con su tamaño y la descripción de la operación (p.ej. "Subsample(4)").
+  Como no depende de la ruta ni de la fecha, un fichero copiado o vuelto a generar con el mismo
+  contenido sigue encontrando sus resultados.
+
+  Los resultados se guardan como PGZ en @a dir/xx/resto.pgz, repartidos en 256 subdirectorios
+  por los dos primeros dígitos de la clave. Cada resultado se escribe en un fichero temporal y se
+  renombra al final, así que varios procesos pueden compartir el directorio.
+
+  Una caché construida con un directorio vacío está desactivada: no encuentra ni guarda nada.
+  Los programas de la biblioteca usan el directorio de la variable de entorno IMAGE_CACHE_DIR.
+
+  \code
+  DiskCache cache(DiskCache::DirFromEnvironment());
+  std::string key;
+  Image icon;
+  if (!cache.Find(path, "Subsample(8)", key, icon)){
+      image.Load(path);
+      icon = image.Subsample(8);
+      cache.Store(key, icon);
+  }
+  \endcode
+**/
+class DiskCache {
+public:
+
+    /**
+      * @brief Constructor.
+      * @param dir directorio de la caché; se crea si no existe. Vacío para desactivarla.
+      */
+    explicit DiskCache (const std::string & dir);
+
+    /**
+      * @brief Directorio indicado en la variable de entorno IMAGE_CACHE_DIR, o "" si no está.
+      */
+    static std::string DirFromEnvironment ();
+
+    /**
+      * @brief Indica si la caché está activa.
+      */
+    bool Enabled () const { return !dir.empty(); }
+
+    /**
+      * @brief Clave de un resultado a partir del contenido del fichero de entrada.
+      * @param data contenido del fichero de entrada.
+      * @param len número de bytes de @a data.
+      * @param op descripción de la operación con sus parámetros.
+      * @return clave de 32 dígitos hexadecimales.
+      */
+    static std::string MakeKey (const unsigned char * data, size_t len, const std::string & op);
+
+    /**
+      * @brief Calcula la clave de un resultado y lo busca.
+      * @param path fichero de entrada.
+      * @param op descripción de la operación con sus parámetros.
+      * @param key Parámetro de salida con la clave, para pasarla a Store(); vacía si la caché
+      * está desactivada o no se pudo leer @a path.
+      * @param image Parámetro de salida con el resultado, si se encuentra.
+      * @return si se encontró el resultado.
+      */
+    bool Find (const char * path, const std::string & op, std::string & key, Image & image) const;
+
+    /**
+      * @brief Busca un resultado por su clave.
+      * @param key clave del resultado.
+      * @param image Parámetro de salida con el resultado, si se encuentra.
+      * @return si se encontró.
+      */
+    bool Lookup (const std::string & key, Image & image) const;
+
+    /**
+      * @brief Guarda un resultado.
+      * @param key clave del resultado. Si está vacía no se hace nada.
+      * @param image resultado a guardar.
+      * @return si se guardó.
+      */
+    bool Store (const std::string & key, const Image & image) const;
+
+    /**
+      * @brief Obtiene el resultado de una operación sobre un fichero pasando por la caché.
+      *
+      * El fichero se proyecta en memoria una sola vez: sirve para calcular la clave y, si el
+      * resultado no está guardado, para decodificar la imagen de entrada.
+      * @param path fichero de entrada.
+      * @param op descripción de la operación con sus parámetros; distinta para cada @a compute.
+      * @param compute función llamada como compute(Image &) que devuelve el resultado. Puede
+      * modificar la imagen de entrada, que se descarta después, para no copiarla.
+      * @param result Parámetro de salida con el resultado.
+      * @return false si no se pudo leer el fichero.
+      */
+    template <class F>
+    bool Derive (const char * path, const std::string & op, F compute, Image & result) const;
+
+private:
+
+    std::string dir;
+
+    std::string EntryPath (const std::string & key) const;
+};
+
+template <class F>
+bool DiskCache::Derive (const char * path, const std::string & op, F compute, Image & result) const {
+    MappedFile file;
+    if (!file.Open(path))
+        return false;
+
+    std::string key;
+    if (Enabled()){
+        key = MakeKey(file.data(), file.size(), op);
+        if (Lookup(key, result))
+            return true;
+    }
+
+    Image source;
+    if (!source.LoadFromMemory(file.data(), file.size()))
+        return false;
+    result = compute(source);
+    Store(key, result);
+    return true;
+}
+
+#endif // _DISK_CACHE_H_
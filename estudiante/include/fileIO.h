@@ -0,0 +1,74 @@
+/**
+  * @file fileIO.h
+  * @brief Fichero cabecera con primitivas de acceso a ficheros sobre llamadas POSIX
+  *
+  * Los lectores y escritores de imágenes trabajan sobre bloques de bytes en memoria. Estas
+  * funciones obtienen esos bloques (lectura completa o proyección en memoria) y los escriben
+  * con el menor número de llamadas al sistema posible.
+  */
+
+#ifndef _FILE_IO_H_
+#define _FILE_IO_H_
+
+#include <cstddef>
+#include <vector>
+#include <sys/uio.h>
+
+/**
+  * @brief Lee un fichero completo.
+  * @param path fichero a leer.
+  * @param data Parámetro de salida con el contenido del fichero.
+  * @return si ha tenido éxito la lectura.
+  */
+bool ReadFileBytes (const char *path, std::vector<unsigned char> &data);
+
+/**
+  * @brief Crea (o trunca) un fichero y escribe en él varios bloques con una sola llamada writev.
+  *
+  * Si el sistema escribe menos bytes de los pedidos, o hay más de IOV_MAX bloques, se repite
+  * la llamada con lo que falta.
+  *
+  * @param path fichero a escribir.
+  * @param iov bloques a escribir, en orden.
+  * @param n número de bloques.
+  * @return si se escribieron todos los bytes.
+  */
+bool WriteFileBlocks (const char *path, const struct iovec *iov, int n);
+
+/**
+  * @brief Fichero de solo lectura proyectado en memoria.
+  *
+  * El fichero permanece proyectado mientras viva el objeto. Los ficheros vacíos se abren
+  * correctamente con data() == 0 y size() == 0.
+  */
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    /**
+      * @brief Proyecta un fichero en memoria, liberando la proyección anterior si la había.
+      * @param path fichero a proyectar.
+      * @return si se pudo abrir y proyectar el fichero.
+      */
+    bool Open (const char *path);
+
+    /**
+      * @brief Libera la proyección.
+      */
+    void Close ();
+
+    const unsigned char *data () const { return addr; }
+    size_t size () const { return length; }
+
+private:
+    unsigned char *addr;
+    size_t length;
+
+    MappedFile (const MappedFile &);
+    MappedFile & operator= (const MappedFile &);
+};
+
+#endif
+
+/* Fin Fichero: fileIO.h */
@@ -8,6 +8,9 @@
 
 
 #include <cstdlib>
+#include <atomic>
+#include <cstdint>
+#include <vector>
 #include "imageIO.h"
 
 
@@ -19,6 +22,43 @@ enum LoadResult: unsigned char {
     READING_ERROR
 };
 
+/**
+  @brief Métodos de binarización adaptativa (ver Image::AdaptiveThreshold()).
+**/
+enum AdaptiveMethod: unsigned char {
+    SAUVOLA,    ///< umbral media * (1 + k * (desviacion / 128 - 1))
+    BRADLEY     ///< umbral media * (1 - k)
+};
+
+/**
+  @brief Interpolación al tomar valores en posiciones no enteras (ver Image::Warp()).
+**/
+enum Interpolation: unsigned char {
+    NEAREST,    ///< valor del pixel mas cercano
+    BILINEAR    ///< media de los cuatro pixeles vecinos ponderada por la distancia
+};
+
+/**
+  @brief Operadores de gradiente de 3x3 (ver Image::Gradient()).
+
+  Los dos son separables: una derivada [-1 0 1] en una direccion y un suavizado [a b a] en la
+  otra.
+**/
+enum GradientOperator: unsigned char {
+    SOBEL,      ///< suavizado [1 2 1]; componentes en [-1020, 1020]
+    SCHARR      ///< suavizado [3 10 3], mas isotropo; componentes en [-4080, 4080]
+};
+
+/**
+  @brief Modulo del gradiente a partir de sus componentes gx y gy.
+**/
+enum GradientNorm: unsigned char {
+    GRADIENT_L1,    ///< |gx| + |gy|
+    GRADIENT_L2     ///< aproximacion entera de sqrt(gx^2 + gy^2), con error menor del 4%
+};
+
+class BitImage;
+
 
 /**
   @brief T.D.A. Imagen
@@ -56,14 +96,61 @@ class Image{
 
 private :
 
+    /**
+      @brief Bloque de píxeles con contador de referencias.
+
+      Varias imágenes pueden ver el mismo bloque (copias, ver CropView()); el bloque se libera
+      cuando lo suelta la última.
+    **/
+    struct PixelBuffer {
+        std::atomic<int> refs;  ///< Imágenes que usan el bloque
+        byte * data;            ///< Píxeles, reservados con new [] salvo que haya @a release
+        void (*release)(byte *, size_t);    ///< Libera @a data si no se reservó con new [] (ver Wrap())
+        size_t size;            ///< Bytes de @a data
+
+        explicit PixelBuffer(byte * d, void (*r)(byte *, size_t) = 0, size_t n = 0)
+            : refs(1), data(d), release(r), size(n) {}
+        ~PixelBuffer() {
+            if (release)
+                release(data, size);
+            else
+                delete [] data;
+        }
+    };
+
+    /**
+      @brief Tabla de punteros a fila con contador de referencias, compartida entre copias.
+
+      Todas las imágenes que comparten una tabla comparten también su PixelBuffer.
+    **/
+    struct RowTable {
+        std::atomic<int> refs;  ///< Imágenes que usan la tabla
+        byte ** rows;           ///< Punteros a fila, reservados con new []
+
+        explicit RowTable(int n) : refs(1), rows(new byte * [n]) {}
+        ~RowTable() { delete [] rows; }
+    };
+
     /**
       @brief Puntero a la imagen almacenada
 
-      img apunta a un array-2D dinámico de bytes que contiene la imagen en sí. Almacena tantos bytes como pixeles tenga la imagen.
+      img es la tabla de punteros a fila de la imagen (los de @a table). Cada fila son cols bytes
+      consecutivos dentro del bloque @a buffer, aunque las filas no tienen por qué estar seguidas
+      ni en orden.
 
     **/
     byte **img;
 
+    /**
+      @brief Tabla de filas de la imagen, posiblemente compartida.
+    **/
+    RowTable *table;
+
+    /**
+      @brief Bloque que contiene los píxeles de la imagen, posiblemente compartido.
+    **/
+    PixelBuffer *buffer;
+
     /**
       @brief Número de filas de la imagen.
     **/
@@ -93,14 +180,30 @@ private :
     **/
     LoadResult LoadFromPGM(const char * file_path);
 
+    /**
+      @brief Lee una imagen comprimida PGZ desde un archivo.
+      @param file_path Ruta del archivo a leer
+      @return LoadResult
+    **/
+    LoadResult LoadFromPGZ(const char * file_path);
+
     /**
       @brief Copy una imagen .
+
+      La copia comparte la tabla de filas y los píxeles de @a orig, así que no cuesta nada;
+      los píxeles solo se copian cuando una de las dos se modifica (ver Detach()).
       @param orig Referencia a la imagen original que vamos a copiar
       @pre Asume que no hay memoria reservada o se ha llamado antes a Destroy()
       @pre Asume this != &orig
     **/
     void Copy(const Image &orig);
 
+    /**
+      @brief Indica si las filas de la imagen están consecutivas y en orden en memoria.
+      @return true si img[i] == img[0] + i * cols para toda fila i.
+    **/
+    bool IsContiguous() const;
+
     /**
       @brief Reserva o copia en memoria una imagen.
       @param nrows Número de filas que tendrá la imagen.
@@ -119,6 +222,48 @@ private :
       */
     void Destroy();
 
+    /**
+      * @brief Prepara la imagen para escribir en sus píxeles.
+      *
+      * Si el bloque de píxeles está compartido con otra imagen, copia los píxeles propios a un
+      * bloque nuevo, de modo que las escrituras no se vean desde las demás imágenes.
+      */
+    void Detach();
+
+    /**
+      * @brief Copia los píxeles a un bloque propio. Parte lenta de Detach().
+      */
+    void Unshare();
+
+    /**
+      * @brief Prepara la imagen para modificar su tabla de filas.
+      *
+      * Si la tabla está compartida se copian los punteros a fila a una tabla propia; los píxeles
+      * siguen compartidos.
+      */
+    void DetachTable();
+
+    /**
+      * @brief Copia filas dispersas en memoria a un bloque contiguo.
+      *
+      * Reparte las filas entre hilos, pide por adelantado el comienzo de las filas de origen
+      * siguientes y, si el bloque es grande, escribe sin pasar por la caché.
+      * @param dst bloque de destino de @a nrows * @a ncols bytes.
+      * @param src punteros a las filas de origen, en el orden en que se escriben.
+      * @param nrows número de filas.
+      * @param ncols bytes de cada fila.
+      */
+    static void GatherInto(byte * dst, const byte * const * src, int nrows, int ncols);
+
+    /**
+      * @brief Suelta una referencia a un bloque compartido y lo libera si era la última.
+      */
+    template <class Shared>
+    static void Release(Shared * p) {
+        if (p && p->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete p;
+    }
+
 public :
 
     /**
@@ -139,6 +284,22 @@ public :
       */
     Image(int nrows, int ncols, byte value=0);
 
+    /**
+      * @brief Crea una imagen sobre un bloque de píxeles ya reservado, sin copiarlo.
+      *
+      * Permite trabajar directamente sobre memoria que no es de la imagen, como un fichero
+      * proyectado con mmap. Las escrituras en la imagen van al bloque mientras no se comparta
+      * (ver Detach()).
+      * @param nrows Número de filas de la imagen.
+      * @param ncols Número de columnas de la imagen.
+      * @param data bloque de nrows * ncols bytes con las filas seguidas.
+      * @param release función a la que se llama con @a data y su tamaño cuando la última imagen
+      * que usa el bloque lo suelta.
+      * @pre nrows > 0, ncols > 0, release != 0
+      * @return La imagen, dueña del bloque.
+      */
+    static Image Wrap(int nrows, int ncols, byte * data, void (*release)(byte *, size_t));
+
     /**
       * @brief Constructor de copias.
       * @param orig Referencia a la imagen original que se quiere copiar.
@@ -146,6 +307,13 @@ public :
       */
     Image (const Image & orig);
 
+    /**
+      * @brief Constructor de movimiento.
+      * @param orig Imagen cuyo contenido pasa a la nueva imagen sin copiar los píxeles.
+      * @post @a orig queda vacía.
+      */
+    Image (Image && orig);
+
     /**
       * @brief Oper ador de tipo destructor.
       * @return void
@@ -161,6 +329,14 @@ public :
       */
     Image & operator= (const Image & orig);
 
+    /**
+      * @brief Operador de asignación por movimiento.
+      * @param orig Imagen cuyo contenido pasa a la imagen que llama sin copiar los píxeles.
+      * @return Una referencia al objeto imagen modificado.
+      * @post @a orig queda vacía.
+      */
+    Image & operator= (Image && orig);
+
     /**
       * @brief Funcion para conocer si una imagen está vacía.
       * @return Si la imagene está vacía
@@ -189,6 +365,14 @@ public :
       */
     int size() const;
 
+    /**
+      * @brief Devuelve los bytes del bloque de píxeles que usa la imagen.
+      * @return size() si la imagen tiene su propio bloque; más si es una vista de otra imagen
+      * (ver CropView()) y mantiene vivo el bloque entero de aquella.
+      * @post la imagen no se modifica.
+      */
+    size_t BufferBytes() const;
+
     /**
       * @brief Asigna el valor valor al píxel (fil, col) de la imagen.
       * @param i Fila de la imagen en la que se encuentra el píxel a escribir .
@@ -215,7 +399,7 @@ public :
       * @brief Consulta el valor del píxel k de la imagen desenrrollada.
       * @param k Índice del píxel
       * @pre 0 <= k < filas*columnas
-      * @return el valor del píxel contenido en (k/filas,k%filas)
+      * @return el valor del píxel contenido en (k/columnas,k%columnas)
       * @post La imagen no se modifica.
       */
     byte get_pixel (int k) const;
@@ -229,8 +413,43 @@ public :
       */
     void set_pixel (int k, byte value);
 
+    /**
+      * @brief Acceso directo a una fila de la imagen.
+      *
+      * Los bucles que recorren la imagen deben obtener el puntero a cada fila una sola vez y
+      * trabajar sobre él, en lugar de llamar a get_pixel/set_pixel por píxel. Si los píxeles
+      * están compartidos con otra imagen (ver CropView()) se copian antes de devolver la fila.
+      * @param i Fila a consultar.
+      * @pre 0 <= i < get_rows()
+      * @return puntero a los get_cols() píxeles de la fila @a i, que son consecutivos.
+      */
+    byte * get_row (int i);
+
+    /**
+      * @brief Acceso de solo lectura a una fila de la imagen.
+      * @param i Fila a consultar.
+      * @pre 0 <= i < get_rows()
+      * @return puntero a los get_cols() píxeles de la fila @a i, que son consecutivos.
+      */
+    const byte * get_row (int i) const;
+
+    /**
+      * @brief Tabla de punteros a fila de la imagen, para recorridos genéricos (ver imageTransform.h).
+      * @return puntero a get_rows() punteros a fila.
+      */
+    byte * const * get_row_table ();
+
+    /**
+      * @brief Tabla de punteros a fila de solo lectura.
+      * @return puntero a get_rows() punteros a fila.
+      */
+    const byte * const * get_row_table () const;
+
     /**
       * @brief Almacena imágenes en disco.
+      *
+      * El formato se elige por la extensión: ".pgz" guarda la imagen comprimida (ver imageCodec.h),
+      * cualquier otra extensión la guarda como PGM.
       * @param file_path Ruta donde se almacenará la imagen.
       * @pre file path debe ser una ruta válida donde almacenar el fichero de salida.
       * @return Devuelve true si la imagen se almacenó con éxito y false en caso contrario.
@@ -241,13 +460,25 @@ public :
     /**
       * @brief Carga en memoria una imagen de disco .
       * @param file_path path Ruta donde se encuentra el archivo desde el que cargar la imagen.
-      * @pre file path debe ser una ruta válida que contenga un fichero . pgm
+      * @pre file path debe ser una ruta válida que contenga un fichero . pgm o . pgz
       * @return Devuelve true si la imagen se carga con éxito y false en caso contrario.
       * @post La imagen previamente almacenada en el objeto que llama a la función se destruye.
       */
     bool Load (const char * file_path);
 
-    // Invierte
+    /**
+      * @brief Carga una imagen PGM o PGZ a partir del contenido de un fichero ya leído.
+      * @param data bytes del fichero (lectura, pread o mmap).
+      * @param len número de bytes de @a data.
+      * @return Devuelve true si la imagen se decodifica con éxito y false en caso contrario.
+      * @post La imagen previamente almacenada en el objeto que llama a la función se destruye.
+      */
+    bool LoadFromMemory (const unsigned char * data, size_t len);
+
+    /**
+     * @brief Calcula el negativo de la imagen: cada pixel p pasa a valer 255 - p.
+     * @post El objeto imagen que llama la funcion es modificado
+     */
     void Invert();
 
     /**
@@ -263,6 +494,32 @@ public :
      */
     void AdjustContrast (byte in1, byte in2, byte out1, byte out2);
 
+    /**
+     * @brief Ecualiza el histograma de la imagen.
+     *
+     * Cada nivel de gris pasa a ser proporcional al numero de pixeles con un nivel menor o
+     * igual, de modo que los niveles resultado quedan repartidos por todo el rango [0, 255].
+     * Una imagen de un solo nivel no se modifica.
+     * @post El objeto imagen que llama la funcion es modificado
+     */
+    void Equalize();
+
+    /**
+     * @brief Ecualizacion adaptativa con limite de contraste (CLAHE).
+     *
+     * La imagen se divide en una rejilla de @a grid_rows x @a grid_cols bloques y cada bloque se
+     * ecualiza con su propio histograma, recortado a @a clip_limit veces el numero medio de
+     * pixeles por nivel para no amplificar el ruido de las zonas uniformes. Cada pixel se
+     * transforma interpolando bilinealmente las tablas de los cuatro bloques mas cercanos,
+     * para que no se noten las fronteras entre bloques.
+     * @param grid_rows numero de bloques en vertical.
+     * @param grid_cols numero de bloques en horizontal.
+     * @param clip_limit limite del histograma; valores de 2 a 4 son habituales.
+     * @pre grid_rows > 0, grid_cols > 0 y clip_limit > 0
+     * @post El objeto imagen que llama la funcion es modificado
+     */
+    void CLAHE(int grid_rows = 8, int grid_cols = 8, double clip_limit = 2.0);
+
     /**
      * @brief Calcula la media de los pixeles de un fragmento de imagen.
      * @param row fila inicial del fragmento.
@@ -275,13 +532,19 @@ public :
 
     /**
      * @brief Genera un icono como reduccion de la imagen original
+     *
+     * Cada pixel del icono es la media redondeada de un bloque factor x factor de la original,
+     * calculada con aritmetica entera.
      * @param factor factor de reduccion de la imagen
+     * @param partial si es true, los pixeles del borde que no completan un bloque forman bloques
+     * mas pequeños en lugar de descartarse
      * @pre factor > 0
      * @return Retorna una imagen reducida de la original
-     * @post La imagen generada tendra dimensiones ancho/factor x alto/factor tomando la parte entera de la division
+     * @post La imagen generada tendra dimensiones ancho/factor x alto/factor tomando la parte entera de la division,
+     * o redondeando hacia arriba si @a partial es true
      * @post El objeto que llama la funcion no se modifica
      */
-    Image Subsample(int factor) const;
+    Image Subsample(int factor, bool partial = false) const;
 
     /**
      * @brief Genera una subimagen de la original.
@@ -289,13 +552,29 @@ public :
      * @param ncol columna inicial del recorte.
      * @param height altura de la subimagen.
      * @param width ancho de la subimagen.
-     * @pre nrow < rows.
-     * @pre ncol < cols.
-     * @return Devuelve una imagen recortada de la original.
+     * @return Devuelve una imagen recortada de la original, de @a height filas y @a width columnas.
+     * La parte del recorte que cae fuera de la original vale 0, también con @a nrow o @a ncol
+     * negativos.
      * @post El objeto que llama la funcion no se modifica.
      */
     Image Crop(int nrow, int ncol, int height, int width) const;
 
+    /**
+     * @brief Genera una subimagen de la original sin copiar sus pixeles.
+     *
+     * El resultado es el mismo que el de Crop(), pero si el recorte cae entero dentro de la
+     * imagen la subimagen comparte los pixeles de la original: solo se crea su tabla de filas.
+     * La primera escritura en cualquiera de las dos copia sus pixeles a un bloque propio, asi
+     * que las modificaciones nunca se ven desde la otra.
+     * @param nrow fila inicial del recorte.
+     * @param ncol columna inicial del recorte.
+     * @param height altura de la subimagen.
+     * @param width ancho de la subimagen.
+     * @return Devuelve una imagen recortada de la original.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    Image CropView(int nrow, int ncol, int height, int width) const;
+
     /**
      * @brief Genera una imagen resultado de la original aumentada x2.
      * @pre En la imagen que llama a la funcion, rows == cols.
@@ -304,18 +583,296 @@ public :
      */
     Image Zoom2X() const;
 
-    // Copia el contenido de la imagen pasada como parámetro a la imagen que llama en la posición indicada.
-    void PaintIn(Image & in, int i, int j);
+    /**
+     * @brief Como Zoom2X(), pero escribe el resultado en @a out.
+     *
+     * Si @a out ya tiene las dimensiones del resultado se escribe sobre sus píxeles (por
+     * ejemplo, memoria proyectada creada con Wrap()) en lugar de reservar una imagen nueva.
+     * @param out Parámetro de salida con la imagen aumentada x2.
+     * @pre En la imagen que llama a la funcion, rows == cols.
+     */
+    void Zoom2X(Image & out) const;
+
+    /**
+     * @brief Transformacion afin de la imagen.
+     *
+     * El pixel (i, j) del resultado toma el valor de la original en la posicion
+     * (y, x) = (m[3] * j + m[4] * i + m[5], m[0] * j + m[1] * i + m[2]), con los centros de los
+     * pixeles en las coordenadas enteras. La matriz es la inversa de la transformacion que se
+     * aplica a la imagen: indica de donde sale cada pixel del resultado.
+     * Las posiciones se avanzan pixel a pixel sumando incrementos en punto fijo con 16 bits de
+     * fraccion, sin multiplicar por la matriz en cada pixel.
+     * @param m coeficientes de la matriz de 2x3, por filas.
+     * @param interp interpolacion al tomar los valores de la original.
+     * @param fill valor de los pixeles que caen fuera de la original.
+     * @return Devuelve la imagen transformada, de las mismas dimensiones que la original.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    Image Warp(const double m[6], Interpolation interp = BILINEAR, byte fill = 0) const;
+
+    /**
+     * @brief Gira la imagen alrededor de su centro.
+     *
+     * Pensado para enderezar documentos escaneados torcidos unos pocos grados: el resultado
+     * conserva las dimensiones de la original, asi que las esquinas se recortan y los huecos
+     * se rellenan con @a fill.
+     * @param degrees angulo en grados, positivo en sentido contrario a las agujas del reloj.
+     * @param interp interpolacion al tomar los valores de la original.
+     * @param fill valor de los pixeles que caen fuera de la original.
+     * @return Devuelve la imagen girada.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    Image Rotate(double degrees, Interpolation interp = BILINEAR, byte fill = 0) const;
+
+    /**
+     * @brief Erosion con un elemento estructurante rectangular.
+     *
+     * Cada pixel del resultado es el minimo de la ventana de @a height x @a width pixeles
+     * centrada en el (para dimensiones pares, el centro es el pixel inferior derecho de los
+     * centrales). Los pixeles fuera de la imagen no cuentan. El coste por pixel no depende
+     * del tamaño de la ventana.
+     * @param height alto del rectangulo.
+     * @param width ancho del rectangulo.
+     * @pre height > 0 y width > 0
+     * @return Devuelve la imagen erosionada.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    Image Erode(int height, int width) const;
+
+    /**
+     * @brief Dilatacion con un elemento estructurante rectangular.
+     *
+     * Cada pixel del resultado es el maximo de la ventana de @a height x @a width pixeles
+     * centrada en el (la reflejada de la de Erode() si alguna dimension es par).
+     * @param height alto del rectangulo.
+     * @param width ancho del rectangulo.
+     * @pre height > 0 y width > 0
+     * @return Devuelve la imagen dilatada.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    Image Dilate(int height, int width) const;
+
+    /**
+     * @brief Apertura: erosion seguida de dilatacion con el mismo rectangulo.
+     *
+     * Elimina los detalles claros menores que el rectangulo.
+     * @pre height > 0 y width > 0
+     * @return Devuelve la imagen abierta.
+     */
+    Image Open(int height, int width) const;
+
+    /**
+     * @brief Cierre: dilatacion seguida de erosion con el mismo rectangulo.
+     *
+     * Rellena los detalles oscuros menores que el rectangulo.
+     * @pre height > 0 y width > 0
+     * @return Devuelve la imagen cerrada.
+     */
+    Image Close(int height, int width) const;
+
+    /**
+     * @brief Gradiente morfologico: dilatacion menos erosion.
+     * @pre height > 0 y width > 0
+     * @return Devuelve una imagen que resalta los bordes.
+     */
+    Image MorphGradient(int height, int width) const;
+
+    /**
+     * @brief Top-hat: la imagen menos su apertura.
+     *
+     * Deja solo los detalles claros menores que el rectangulo, p.ej. para corregir un fondo
+     * irregular antes de binarizar.
+     * @pre height > 0 y width > 0
+     * @return Devuelve el top-hat de la imagen.
+     */
+    Image TopHat(int height, int width) const;
+
+    /**
+     * @brief Histograma de la imagen.
+     * @param hist Parámetro de salida: hist[v] es el número de pixeles de valor v.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    void Histogram(unsigned long long hist[256]) const;
+
+    /**
+     * @brief Umbral de Otsu: el que maximiza la varianza entre las dos clases del histograma.
+     * @return Devuelve el umbral t; Threshold(t) separa la imagen en esas dos clases.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    byte OtsuThreshold() const;
+
+    /**
+     * @brief Binarizacion con un umbral global.
+     * @param t umbral.
+     * @return Devuelve una imagen con 255 en los pixeles mayores que @a t y 0 en el resto.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    Image Threshold(byte t) const;
+
+    /**
+     * @brief Como Threshold(), pero con el resultado empaquetado a un bit por pixel.
+     * @param t umbral.
+     * @return Devuelve una imagen binaria con 1 en los pixeles mayores que @a t.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    BitImage ThresholdBits(byte t) const;
+
+    /**
+     * @brief Binarizacion con un umbral propio para cada pixel.
+     *
+     * El umbral de cada pixel se calcula a partir de la media (y, con SAUVOLA, la desviacion
+     * tipica) de la ventana de @a window x @a window pixeles centrada en el, recortada a la
+     * imagen. Las sumas de cada ventana se obtienen de una imagen integral, asi que el coste
+     * por pixel no depende del tamaño de la ventana.
+     * @param method SAUVOLA o BRADLEY.
+     * @param window lado de la ventana; se suele usar del orden del doble del grosor de los trazos.
+     * @param k sensibilidad: alrededor de 0.34 para SAUVOLA y de 0.15 para BRADLEY.
+     * @pre window > 0
+     * @return Devuelve una imagen con 255 en los pixeles mayores que su umbral y 0 en el resto.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    Image AdaptiveThreshold(AdaptiveMethod method, int window, double k) const;
+
+    /**
+     * @brief Como AdaptiveThreshold(), pero con el resultado empaquetado a un bit por pixel.
+     * @pre window > 0
+     * @return Devuelve una imagen binaria con 1 en los pixeles mayores que su umbral.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    BitImage AdaptiveThresholdBits(AdaptiveMethod method, int window, double k) const;
+
+    /**
+     * @brief Modulo del gradiente, saturado a 255.
+     *
+     * Las derivadas de cada fila se calculan con las tres filas que la rodean y se combinan en
+     * el modulo en la misma pasada, sin guardar imagenes de gx y gy. Fuera de la imagen se
+     * repiten los pixeles del borde.
+     * @param op operador de gradiente.
+     * @param norm forma de calcular el modulo.
+     * @param orientation si no es nulo, Parámetro de salida con la direccion del gradiente de
+     * cada pixel, cuantizada a 0 (horizontal), 1 (diagonal con gx y gy del mismo signo),
+     * 2 (vertical) o 3 (la otra diagonal); vale 0 donde el gradiente es nulo.
+     * @return Devuelve una imagen con min(modulo, 255) en cada pixel.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    Image Gradient(GradientOperator op = SOBEL, GradientNorm norm = GRADIENT_L1, Image * orientation = nullptr) const;
+
+    /**
+     * @brief Como Gradient(), pero con el modulo completo en 16 bits.
+     * @param magnitude Parámetro de salida con el modulo, fila a fila (rows * cols valores).
+     */
+    void Gradient16(std::vector<uint16_t> & magnitude, GradientOperator op = SOBEL,
+                    GradientNorm norm = GRADIENT_L1, Image * orientation = nullptr) const;
+
+    /**
+     * @brief Valor absoluto de la laplaciana de 4 vecinos, saturado a 255.
+     *
+     * La laplaciana es la suma de los cuatro vecinos menos cuatro veces el pixel. Fuera de la
+     * imagen se repiten los pixeles del borde.
+     * @return Devuelve una imagen con min(|laplaciana|, 255) en cada pixel.
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    Image Laplacian() const;
+
+    /**
+     * @brief Como Laplacian(), pero con el valor con signo en 16 bits, en [-1020, 1020].
+     * @param laplacian Parámetro de salida con la laplaciana, fila a fila (rows * cols valores).
+     */
+    void Laplacian16(std::vector<int16_t> & laplacian) const;
+
+    /**
+     * @brief Copia el contenido de una imagen sobre la imagen que llama.
+     * @param in imagen que se pinta.
+     * @param i fila de la imagen que llama donde se sitúa la esquina superior izquierda de @a in.
+     * @param j columna de la imagen que llama donde se sitúa la esquina superior izquierda de @a in.
+     * @post Los píxeles de @a in que quedan fuera de la imagen que llama se descartan.
+     * @post La imagen que llama la funcion es modificada.
+     */
+    void PaintIn(const Image & in, int i, int j);
 
     /**
      * @brief Baraja pseudoaleatoriamente las filas de una imagen.
+     *
+     * Solo se reordena la tabla de punteros a fila: las filas quedan dispersas en memoria.
+     * Para obtener las filas barajadas seguidas en memoria, ver GatherRows().
      * @pre rows < 9973.
      * @post La imagen que llama la funcion es modificada.
      */
     void ShuffleRows();
 
+    /**
+     * @brief Genera una imagen con las filas de la original en otro orden, seguidas en memoria.
+     * @param index fila de la original que ocupa cada fila del resultado; get_rows() elementos.
+     * Las filas pueden repetirse.
+     * @pre 0 <= index[i] < get_rows()
+     * @return Devuelve una imagen de las mismas dimensiones cuya fila i es la fila index[i].
+     * @post El objeto que llama la funcion no se modifica.
+     */
+    Image GatherRows(const int * index) const;
+
 } ;
 
+// Los accesos a píxeles se definen en la cabecera para que el compilador pueda integrarlos
+// en los bucles de las operaciones.
+
+inline int Image::get_rows() const {
+    return rows;
+}
+
+inline int Image::get_cols() const {
+    return cols;
+}
+
+inline int Image::size() const {
+    return rows * cols;
+}
+
+inline size_t Image::BufferBytes() const {
+    return Empty() ? 0 : buffer->size;
+}
+
+inline void Image::Detach () {
+    if (!Empty() && buffer->refs.load(std::memory_order_acquire) > 1)
+        Unshare();
+}
+
+inline void Image::set_pixel (int i, int j, byte value) {
+    Detach();
+    img[i][j] = value;
+}
+
+inline byte Image::get_pixel (int i, int j) const {
+    return img[i][j];
+}
+
+// Las filas pueden no estar en orden en memoria (ShuffleRows), así que el índice lineal
+// se traduce a (fila, columna)
+inline void Image::set_pixel (int k, byte value) {
+    set_pixel(k / cols, k % cols, value);
+}
+
+inline byte Image::get_pixel (int k) const {
+    return get_pixel(k / cols, k % cols);
+}
+
+inline byte * Image::get_row (int i) {
+    Detach();
+    return img[i];
+}
+
+inline const byte * Image::get_row (int i) const {
+    return img[i];
+}
+
+inline byte * const * Image::get_row_table () {
+    Detach();
+    return img;
+}
+
+inline const byte * const * Image::get_row_table () const {
+    return img;
+}
+
 
 #endif // _IMAGEN_H_
 
@@ -0,0 +1,167 @@
+/**
+ * @file imageCache.h
+ * @brief Cabecera para la caché en memoria de imágenes decodificadas y resultados derivados
+ */
+
+#ifndef _IMAGE_CACHE_H_
+#define _IMAGE_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <image.h>
+
+/**
+  @brief Estadísticas de una ImageCache.
+**/
+struct ImageCacheStats {
+    uint64_t hits;        ///< Consultas encontradas
+    uint64_t misses;      ///< Consultas no encontradas
+    uint64_t insertions;  ///< Imágenes insertadas
+    uint64_t evictions;   ///< Imágenes expulsadas por falta de espacio
+    size_t bytes;         ///< Bytes ocupados por las imágenes guardadas
+    size_t entries;       ///< Número de imágenes guardadas
+};
+
+/**
+  @brief Caché LRU de imágenes con presupuesto en bytes, segura entre hilos.
+
+  Guarda imágenes decodificadas y resultados de operaciones sobre ellas con una clave formada
+  por la ruta del fichero, su fecha de modificación y la cadena de operaciones aplicada
+  (p.ej. "Subsample(4)"). Si el fichero cambia en disco su fecha cambia, y con ella la clave, así
+  que las entradas antiguas dejan de encontrarse y acaban expulsadas.
+
+  Las claves se reparten entre varios fragmentos, cada uno con su cerrojo, su lista LRU y su
+  parte del presupuesto, para que los hilos que consultan claves distintas no se esperen.
+  Guardar y entregar imágenes no copia píxeles: Image comparte sus píxeles entre copias. Solo
+  las vistas de otra imagen (ver Image::CropView()) se copian al guardarlas, para no mantener
+  vivos los píxeles de la original.
+
+  Uso típico:
+
+  \code
+  ImageCache cache(256 << 20);
+  Image icon;
+  cache.Derive(path, "Subsample(8)", [](const Image & im) { return im.Subsample(8); }, icon);
+  \endcode
+**/
+class ImageCache {
+public:
+
+    /**
+      * @brief Constructor.
+      * @param budget bytes máximos que ocupan las imágenes guardadas.
+      * @param nshards número de fragmentos. Por defecto, 16.
+      */
+    explicit ImageCache (size_t budget, int nshards = 16);
+
+    /**
+      * @brief Forma la clave de una imagen derivada de un fichero.
+      * @param path ruta del fichero de origen.
+      * @param op cadena de operaciones aplicada; vacía para la imagen tal cual se lee.
+      * @param key Parámetro de salida con la clave.
+      * @return false si no puede consultarse la fecha del fichero.
+      */
+    static bool MakeKey (const char * path, const std::string & op, std::string & key);
+
+    /**
+      * @brief Busca una imagen.
+      * @param key clave de la imagen.
+      * @param image Parámetro de salida con la imagen, si se encuentra.
+      * @return si se encontró.
+      */
+    bool Get (const std::string & key, Image & image);
+
+    /**
+      * @brief Guarda una imagen, expulsando las menos usadas si no cabe en el presupuesto.
+      *
+      * Las imágenes mayores que el presupuesto de un fragmento no se guardan.
+      * @param key clave de la imagen; si ya existía se sustituye.
+      * @param image imagen a guardar.
+      */
+    void Put (const std::string & key, const Image & image);
+
+    /**
+      * @brief Lee una imagen de disco pasando por la caché.
+      * @param path ruta del fichero.
+      * @param image Parámetro de salida con la imagen.
+      * @return si se pudo leer.
+      */
+    bool Load (const char * path, Image & image);
+
+    /**
+      * @brief Obtiene el resultado de una operación sobre un fichero pasando por la caché.
+      *
+      * Si el resultado no está guardado se lee el fichero (también a través de la caché), se
+      * calcula con @a compute y se guarda. Cada llamada cuenta como una sola consulta, la del
+      * resultado.
+      * @param path ruta del fichero de origen.
+      * @param op descripción de la operación con sus parámetros; distinta para cada @a compute.
+      * @param compute función llamada como compute(const Image &) que devuelve el resultado.
+      * @param result Parámetro de salida con el resultado.
+      * @return false si no se pudo leer el fichero.
+      */
+    template <class F>
+    bool Derive (const char * path, const std::string & op, F compute, Image & result);
+
+    /**
+      * @brief Estadísticas acumuladas de todos los fragmentos.
+      */
+    ImageCacheStats Stats () const;
+
+    /**
+      * @brief Vacía la caché. Las estadísticas de consultas se mantienen.
+      */
+    void Clear ();
+
+private:
+
+    struct Entry {
+        std::string key;
+        Image image;
+        size_t bytes;
+    };
+
+    struct Shard {
+        mutable std::mutex m;
+        std::list<Entry> lru;  // la más reciente al principio
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        size_t bytes;
+        uint64_t hits, misses, insertions, evictions;
+    };
+
+    std::vector<Shard> shards;
+    size_t shard_budget;
+
+    Shard & ShardFor (const std::string & key);
+
+    // Get() y Load() que solo cuentan la consulta en las estadísticas si @a count
+    bool Lookup (const std::string & key, Image & image, bool count);
+    bool Load (const char * path, Image & image, bool count);
+
+    ImageCache (const ImageCache &);
+    ImageCache & operator= (const ImageCache &);
+};
+
+template <class F>
+bool ImageCache::Derive (const char * path, const std::string & op, F compute, Image & result){
+    std::string key;
+    if (!MakeKey(path, op, key))
+        return false;
+    if (Get(key, result))
+        return true;
+
+    Image source;
+    if (!Load(path, source, false))
+        return false;
+    result = compute(source);
+    Put(key, result);
+    return true;
+}
+
+#endif // _IMAGE_CACHE_H_
@@ -0,0 +1,73 @@
+/**
+  * @file imageCodec.h
+  * @brief Fichero cabecera para el códec del formato comprimido PGZ
+  *
+  * Un fichero PGZ almacena una imagen de grises dividida en tiras de filas independientes.
+  * Cada tira se filtra fila a fila con un predictor al estilo PNG (None, Sub, Up, Avg, Paeth)
+  * y el resultado se comprime con un LZ77 orientado a bytes. Las tiras que no se reducen así
+  * se guardan sin comprimir. Al ser independientes, las tiras se codifican y decodifican en paralelo.
+  *
+  * Formato (enteros de 32 bits little-endian):
+  * - "PZ", versión (1 byte), reservado (1 byte)
+  * - filas, columnas, filas por tira, número de tiras
+  * - tamaño comprimido de cada tira
+  * - datos de cada tira, en orden: un byte de modo (0 sin comprimir, 1 filtrado + LZ) y su contenido
+  */
+
+#ifndef _IMAGEN_CODEC_H_
+#define _IMAGEN_CODEC_H_
+
+#include <cstddef>
+#include <vector>
+
+/**
+  * @brief Comprime un bloque de bytes con el LZ77 del formato PGZ.
+  * @param src bytes a comprimir.
+  * @param n número de bytes de @a src.
+  * @param out vector al que se añaden los bytes comprimidos.
+  */
+void LZCompress (const unsigned char *src, size_t n, std::vector<unsigned char> &out);
+
+/**
+  * @brief Descomprime un bloque generado por LZCompress.
+  * @param src bytes comprimidos.
+  * @param n número de bytes de @a src.
+  * @param dst destino de los datos descomprimidos.
+  * @param dst_len número exacto de bytes que debe producir la descompresión.
+  * @return false si los datos están corruptos o no producen exactamente @a dst_len bytes.
+  */
+bool LZDecompress (const unsigned char *src, size_t n, unsigned char *dst, size_t dst_len);
+
+/**
+  * @brief Codifica una tira de filas: filtrado predictivo seguido de LZCompress.
+  * @param pixels primera fila de la tira; las filas son consecutivas en memoria.
+  * @param rows filas de la tira.
+  * @param cols columnas de la imagen.
+  * @param out vector al que se añade la tira codificada.
+  */
+void EncodeStrip (const unsigned char *pixels, int rows, int cols, std::vector<unsigned char> &out);
+
+/**
+  * @brief Decodifica una tira generada por EncodeStrip.
+  * @param src tira codificada.
+  * @param n número de bytes de @a src.
+  * @param pixels destino de las @a rows x @a cols filas decodificadas.
+  * @param rows filas de la tira.
+  * @param cols columnas de la imagen.
+  * @return false si la tira está corrupta.
+  */
+bool DecodeStrip (const unsigned char *src, size_t n, unsigned char *pixels, int rows, int cols);
+
+/**
+  * @brief Decodifica una imagen PGZ completa que ya está en memoria.
+  * @param data contenido del fichero.
+  * @param len número de bytes de @a data.
+  * @param rows Parámetro de salida con las filas de la imagen.
+  * @param cols Parámetro de salida con las columnas de la imagen.
+  * @return puntero a @a rows x @a cols bytes reservados con new[] o 0 si los datos no son válidos.
+  */
+unsigned char *DecodePGZImage (const unsigned char *data, size_t len, int& rows, int& cols);
+
+#endif
+
+/* Fin Fichero: imageCodec.h */
@@ -0,0 +1,48 @@
+/**
+ * @file imageCompare.h
+ * @brief Cabecera para la comparación de imágenes
+ */
+
+#ifndef _IMAGE_COMPARE_H_
+#define _IMAGE_COMPARE_H_
+
+#include <image.h>
+
+/**
+  @brief Medidas de la diferencia entre dos imágenes de las mismas dimensiones.
+**/
+struct ImageDiff {
+    long long differing;  ///< Número de píxeles distintos
+    int max_diff;         ///< Mayor diferencia absoluta entre dos píxeles
+    double mse;           ///< Error cuadrático medio
+    double psnr;          ///< Relación señal/ruido de pico en dB; infinito si las imágenes son iguales
+};
+
+/**
+  * @brief Indica si dos imágenes son exactamente iguales.
+  *
+  * Compara fila a fila con memcmp y deja de comparar en la primera fila distinta.
+  * @return true si tienen las mismas dimensiones y los mismos píxeles.
+  */
+bool ImagesEqual (const Image & a, const Image & b);
+
+/**
+  * @brief Calcula el número de píxeles distintos, la mayor diferencia, el MSE y el PSNR.
+  * @pre @a a y @a b tienen las mismas dimensiones.
+  * @return Devuelve las medidas de la diferencia.
+  */
+ImageDiff CompareImages (const Image & a, const Image & b);
+
+/**
+  * @brief Índice de similitud estructural (SSIM) medio de dos imágenes.
+  *
+  * Media del SSIM de todas las ventanas de @a window x @a window píxeles contenidas en la
+  * imagen, con pesos uniformes. Las medias, varianzas y covarianzas de cada ventana se obtienen
+  * de imágenes integrales, así que el coste por píxel no depende del tamaño de la ventana.
+  * @param window lado de las ventanas; si la imagen es más pequeña se usa su lado menor.
+  * @pre @a a y @a b tienen las mismas dimensiones y window > 0.
+  * @return Devuelve un valor en [-1, 1]; 1 si las imágenes son iguales.
+  */
+double ImageSSIM (const Image & a, const Image & b, int window = 8);
+
+#endif // _IMAGE_COMPARE_H_
@@ -0,0 +1,88 @@
+/**
+ * @file imageHash.h
+ * @brief Cabecera para los hashes perceptuales de imágenes y el índice por distancia de Hamming
+ */
+
+#ifndef _IMAGE_HASH_H_
+#define _IMAGE_HASH_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <image.h>
+
+/**
+  @brief Tipos de hash perceptual.
+
+  Los tres resumen la imagen en 64 bits de modo que imágenes parecidas (reescaladas,
+  recomprimidas, con el contraste retocado...) dan hashes a poca distancia de Hamming.
+**/
+enum HashKind: unsigned char {
+    AHASH,  ///< Media: reducción a 8x8 y un bit por píxel, si supera la media
+    DHASH,  ///< Diferencias: reducción a 9x8 y un bit por par de vecinos, si crece hacia la derecha
+    PHASH   ///< DCT: reducción a 32x32 y un bit por coeficiente de baja frecuencia, si supera la mediana
+};
+
+/**
+  * @brief Hash perceptual de una imagen.
+  *
+  * La imagen se reduce con Image::Subsample y después con medias de bloques hasta el tamaño
+  * que usa cada hash, así que el coste lo marca una sola pasada por los píxeles.
+  * @param image imagen a resumir.
+  * @param kind tipo de hash.
+  * @return Devuelve el hash; 0 si la imagen está vacía.
+  */
+uint64_t PerceptualHash (const Image & image, HashKind kind = DHASH);
+
+/**
+  * @brief Número de bits distintos de dos hashes.
+  */
+inline int HammingDistance (uint64_t a, uint64_t b) {
+    return __builtin_popcountll(a ^ b);
+}
+
+/**
+  @brief Índice de hashes para buscar los que están a poca distancia de Hamming de uno dado.
+
+  Es un árbol BK: cada nodo cuelga de su padre con la distancia entre ambos, y la desigualdad
+  triangular permite descartar las ramas cuya distancia al nodo difiere en más del radio de la
+  buscada. Una búsqueda con radio pequeño visita una fracción pequeña de los nodos, en lugar de
+  comparar con todos.
+**/
+class HashIndex {
+public:
+
+    /**
+      * @brief Añade un hash al índice.
+      * @param hash hash a añadir; puede estar repetido.
+      * @param id identificador que devuelven las búsquedas que lo encuentren.
+      */
+    void Add (uint64_t hash, int id);
+
+    /**
+      * @brief Busca los hashes a distancia menor o igual que @a radius de @a hash.
+      * @param hash hash buscado.
+      * @param radius distancia máxima.
+      * @param ids Parámetro de salida con los identificadores encontrados, en ningún orden concreto.
+      */
+    void Query (uint64_t hash, int radius, std::vector<int> & ids) const;
+
+    /**
+      * @brief Número de hashes del índice.
+      */
+    size_t size () const { return nodes.size(); }
+
+private:
+
+    struct Node {
+        uint64_t hash;
+        int id;
+        int dist;         // distancia al padre
+        int first_child;  // -1 si no tiene hijos
+        int next_sibling; // siguiente hijo del mismo padre, o -1
+    };
+
+    std::vector<Node> nodes;
+};
+
+#endif // _IMAGE_HASH_H_
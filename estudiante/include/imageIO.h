@@ -2,13 +2,15 @@
   * @file imageIO.h
   * @brief Fichero cabecera para la E/S de imágenes
   *
-  * Permite la E/S de archivos de tipo PGM,PPM
+  * Permite la E/S de archivos de tipo PGM,PPM, PBM binario y del formato comprimido PGZ
   *
   */
 
 #ifndef _IMAGEN_ES_H_
 #define _IMAGEN_ES_H_
 
+#include <cstddef>
+
 /**
   * @brief Tipo de imagen
   *
@@ -17,7 +19,80 @@
   *
   * @see ReadImageKind
   */
-enum ImageKind {IMG_UNKNOWN, IMG_PGM, IMG_PPM};
+enum ImageKind {IMG_UNKNOWN, IMG_PGM, IMG_PPM, IMG_PGZ, IMG_PBM};
+
+/**
+  * @brief Mayor número de filas o columnas que se acepta al leer una cabecera
+  */
+const int PNM_MAX_DIMENSION = 65535;
+
+/**
+  * @brief Cabecera de un fichero PNM (PGM, PPM, PBM)
+  *
+  * @see ParsePNMHeader
+  */
+struct PNMHeader {
+    ImageKind kind;   ///< Tipo de imagen según el número mágico
+    int rows;         ///< Filas de la imagen
+    int cols;         ///< Columnas de la imagen
+    int maxval;       ///< Valor máximo de gris; 1 en PBM, que no lo lleva
+    unsigned offset;  ///< Posición del primer byte de los píxeles
+};
+
+/**
+  * @brief Longitud máxima de la cabecera que genera FormatPGMHeader
+  */
+const int PGM_HEADER_MAX = 32;
+
+/**
+  * @brief Analiza la cabecera de una imagen PNM contenida en un bloque de bytes
+  *
+  * No reserva memoria ni usa flujos. Admite comentarios (desde '#' hasta el fin de
+  * línea) entre cualquier par de campos y exige que el valor máximo esté separado de
+  * los píxeles por exactamente un carácter blanco.
+  *
+  * @param data inicio del fichero (lectura, pread o mmap).
+  * @param len número de bytes disponibles en @a data.
+  * @param h Parámetro de salida con la cabecera.
+  * @return si la cabecera es válida y está completa dentro de @a data. Solo se aceptan
+  * imágenes de 8 bits (maxval <= 255) o PBM binarias (P4), con dimensiones entre 1 y
+  * PNM_MAX_DIMENSION.
+  */
+bool ParsePNMHeader (const unsigned char *data, size_t len, PNMHeader &h);
+
+/**
+  * @brief Escribe la cabecera de una imagen PGM binaria en un buffer
+  *
+  * @param buf buffer de al menos PGM_HEADER_MAX bytes.
+  * @param rows filas de la imagen
+  * @param cols columnas de la imagen
+  * @return número de bytes escritos en @a buf
+  */
+int FormatPGMHeader (char *buf, int rows, int cols);
+
+/**
+  * @brief Decodifica una imagen PGM que ya está en memoria
+  *
+  * @param data contenido del fichero.
+  * @param len número de bytes de @a data.
+  * @param rows Parámetro de salida con las filas de la imagen.
+  * @param cols Parámetro de salida con las columnas de la imagen.
+  * @return puntero a @a rows x @a cols bytes reservados con new[] o 0 si los datos no son válidos.
+  */
+unsigned char *DecodePGMImage (const unsigned char *data, size_t len, int& rows, int& cols);
+
+/**
+  * @brief Decodifica una imagen PGM o PGZ que ya está en memoria
+  *
+  * El formato se elige por el número mágico del bloque.
+  *
+  * @param data contenido del fichero.
+  * @param len número de bytes de @a data.
+  * @param rows Parámetro de salida con las filas de la imagen.
+  * @param cols Parámetro de salida con las columnas de la imagen.
+  * @return puntero a @a rows x @a cols bytes reservados con new[] o 0 si los datos no son válidos.
+  */
+unsigned char *DecodeImageBuffer (const unsigned char *data, size_t len, int& rows, int& cols);
 
 /**
   * @brief Devuelve el tipo de imagen del archivo
@@ -57,8 +132,76 @@ unsigned char *ReadPGMImage (const char *path, int& rows, int& cols);
 bool WritePGMImage (const char *path, const unsigned char *datos,
                     const int rows, const int cols);
 
+/**
+  * @brief Lee una imagen de tipo PGZ (grises comprimidos, ver imageCodec.h)
+  *
+  * Las tiras de la imagen se decodifican en paralelo.
+  *
+  * @param path archivo a leer
+  * @param rows Parámetro de salida con las filas de la imagen.
+  * @param cols Parámetro de salida con las columnas de la imagen.
+  * @return puntero a una nueva zona de memoria con @a filas x @a columnas bytes,
+  * igual que ReadPGMImage. En caso de que no se pueda leer, se devuelve cero (0).
+  */
+unsigned char *ReadPGZImage (const char *path, int& rows, int& cols);
 
+/**
+  * @brief Escribe una imagen de tipo PGZ (grises comprimidos, ver imageCodec.h)
+  *
+  * Las tiras de la imagen se codifican en paralelo.
+  *
+  * @param path archivo a escribir
+  * @param datos punteros a los @a f x @a c bytes de la imagen de grises.
+  * @param rows filas de la imagen
+  * @param cols columnas de la imagen
+  * @return si ha tenido éxito en la escritura.
+  */
+bool WritePGZImage (const char *path, const unsigned char *datos,
+                    const int rows, const int cols);
 
+/**
+  * @brief Bytes que ocupa cada fila de una imagen PBM binaria
+  */
+inline int PBMRowBytes (int cols){
+  return (cols + 7) / 8;
+}
+
+/**
+  * @brief Decodifica una imagen PBM binaria (P4) que ya está en memoria
+  *
+  * @param data contenido del fichero.
+  * @param len número de bytes de @a data.
+  * @param rows Parámetro de salida con las filas de la imagen.
+  * @param cols Parámetro de salida con las columnas de la imagen.
+  * @return puntero a @a rows x PBMRowBytes(@a cols) bytes reservados con new[], con los píxeles
+  * tal como van en el fichero (8 por byte empezando por el bit más significativo, 1 = negro),
+  * o 0 si los datos no son válidos.
+  */
+unsigned char *DecodePBMImage (const unsigned char *data, size_t len, int& rows, int& cols);
+
+/**
+  * @brief Lee una imagen PBM binaria (P4)
+  *
+  * @param path archivo a leer
+  * @param rows Parámetro de salida con las filas de la imagen.
+  * @param cols Parámetro de salida con las columnas de la imagen.
+  * @return puntero a una nueva zona de memoria con las filas empaquetadas, igual que
+  * DecodePBMImage. En caso de que no se pueda leer, se devuelve cero (0).
+  */
+unsigned char *ReadPBMImage (const char *path, int& rows, int& cols);
+
+/**
+  * @brief Escribe una imagen PBM binaria (P4)
+  *
+  * @param path archivo a escribir
+  * @param datos @a rows x PBMRowBytes(@a cols) bytes con las filas empaquetadas como en el
+  * fichero (8 píxeles por byte empezando por el bit más significativo, 1 = negro).
+  * @param rows filas de la imagen
+  * @param cols columnas de la imagen
+  * @return si ha tenido éxito en la escritura.
+  */
+bool WritePBMImage (const char *path, const unsigned char *datos,
+                    const int rows, const int cols);
 
 #endif
 
@@ -0,0 +1,117 @@
+/**
+ * @file imageKernels.h
+ * @brief Cabecera para los núcleos de cálculo con selección del juego de instrucciones en ejecución
+ *
+ * Los bucles internos de las operaciones de Image se compilan varias veces, una por nivel de
+ * instrucciones SIMD (ver kernelsImpl.inc). Al primer uso se detectan las capacidades de la
+ * CPU y se elige la tabla de funciones del mejor nivel disponible, de modo que un mismo
+ * binario aprovecha AVX2/AVX-512 donde existen y sigue funcionando en máquinas solo SSE4.
+ *
+ * La variable de entorno IMAGE_CPU_TIER (baseline, sse4.2, avx2, avx512) fuerza un nivel
+ * concreto, siempre que la CPU lo admita; sirve para comparar niveles entre sí.
+ */
+
+#ifndef _IMAGE_KERNELS_H_
+#define _IMAGE_KERNELS_H_
+
+#include <cstdint>
+
+/**
+  @brief Niveles de instrucciones para los que se compilan los núcleos.
+**/
+enum CpuTier { TIER_BASELINE, TIER_SSE42, TIER_AVX2, TIER_AVX512, TIER_COUNT };
+
+/**
+  @brief Tabla con una implementación de cada núcleo.
+
+  Todos los niveles producen exactamente el mismo resultado.
+**/
+struct KernelTable {
+    /// dst[k] = 255 - src[k], 0 <= k < n
+    void (*invert)(const unsigned char *src, unsigned char *dst, int n);
+
+    /// dst[k] = lut[src[k]], 0 <= k < n
+    void (*lut)(const unsigned char *src, unsigned char *dst, int n, const unsigned char *lut);
+
+    /// Fila par de Zoom2X: out[2k] = in[k], out[2k+1] = media redondeada de in[k] e in[k+1].
+    /// Escribe 2 * n_in - 1 píxeles.
+    void (*zoom_row)(const unsigned char *in, unsigned char *out, int n_in);
+
+    /// Fila impar de Zoom2X a partir de las filas pares de arriba y abajo, de n píxeles
+    void (*zoom_mid)(const unsigned char *up, const unsigned char *down, unsigned char *out, int n);
+
+    /// acc[k] += suma de row[k * factor + t], 0 <= t < factor, para 0 <= k < n_out
+    void (*block_sum)(const unsigned char *row, unsigned *acc, int n_out, int factor);
+
+    /// out[k] = min(a[k], b[k]), 0 <= k < n. @a out puede ser @a a o @a b.
+    void (*pixel_min)(const unsigned char *a, const unsigned char *b, unsigned char *out, int n);
+
+    /// out[k] = max(a[k], b[k]), 0 <= k < n. @a out puede ser @a a o @a b.
+    void (*pixel_max)(const unsigned char *a, const unsigned char *b, unsigned char *out, int n);
+
+    /// dst[k] = 255 si src[k] > t, 0 si no, 0 <= k < n
+    void (*threshold)(const unsigned char *src, unsigned char *dst, int n, unsigned char t);
+
+    /// Bit k de la palabra dst[k / 64] (de menos a más significativo) a 1 si src[k] > t.
+    /// Escribe (n + 63) / 64 palabras; los bits que sobran de la última quedan a 0.
+    void (*pack_threshold)(const unsigned char *src, uint64_t *dst, int n, unsigned char t);
+
+    /// Número de bits a 1 en las palabras p[0] .. p[n - 1]
+    long long (*popcount)(const uint64_t *p, int n);
+
+    /// Diferencias entre a[k] y b[k], 0 <= k < n <= 65535: devuelve la suma de los cuadrados,
+    /// y en @a differ y @a max_diff el número de píxeles distintos y la mayor diferencia absoluta
+    unsigned (*diff)(const unsigned char *a, const unsigned char *b, int n, unsigned *differ, unsigned char *max_diff);
+
+    /// Interpolación en punto fijo: out[k] = (a[k] * (256 - w[k]) + b[k] * w[k] + 2^15) >> 16,
+    /// con a[k], b[k] valores con 8 bits de fracción y 0 <= w[k] <= 256
+    void (*blend_q8)(const uint16_t *a, const uint16_t *b, const uint16_t *w, unsigned char *out, int n);
+
+    /// Interpolación sin redondear: out[k] = a[k] * (256 - w[k]) + b[k] * w[k], con 8 bits de
+    /// fracción, para 0 <= w[k] <= 256. Junto con blend_q8 da la interpolación bilineal.
+    void (*lerp_q8)(const unsigned char *a, const unsigned char *b, const uint16_t *w, uint16_t *out, int n);
+
+    /// Gradiente 3x3 separable de la fila mid, con las de arriba y abajo; las tres deben poder
+    /// leerse en [-1, n]. Derivada [-1 0 1] y suavizado [a b a]:
+    /// gx[k] = a * (up[k+1] - up[k-1]) + b * (mid[k+1] - mid[k-1]) + a * (down[k+1] - down[k-1]),
+    /// gy[k] igual con las derivadas en vertical (down - up).
+    void (*gradient)(const unsigned char *up, const unsigned char *mid, const unsigned char *down,
+                     int a, int b, int16_t *gx, int16_t *gy, int n);
+
+    /// Módulo: out[k] = |gx[k]| + |gy[k]| si l2 == 0; si no, (983 * max + 407 * min + 512) >> 10
+    /// de |gx[k]| y |gy[k]|, que aproxima sqrt(gx^2 + gy^2)
+    void (*magnitude)(const int16_t *gx, const int16_t *gy, uint16_t *out, int n, int l2);
+
+    /// Laplaciana de 4 vecinos de la fila mid, que debe poder leerse en [-1, n]:
+    /// out[k] = up[k] + down[k] + mid[k-1] + mid[k+1] - 4 * mid[k]
+    void (*laplacian)(const unsigned char *up, const unsigned char *mid, const unsigned char *down, int16_t *out, int n);
+
+    /// out[k] = min(in[k], 255), 0 <= k < n
+    void (*saturate_u8)(const uint16_t *in, unsigned char *out, int n);
+};
+
+/**
+  * @brief Tabla de núcleos del nivel activo.
+  *
+  * El nivel se elige una sola vez, en la primera llamada.
+  */
+const KernelTable & Kernels ();
+
+/**
+  * @brief Nivel activo de los núcleos.
+  */
+CpuTier ActiveTier ();
+
+/**
+  * @brief Tabla de un nivel concreto.
+  * @param tier nivel pedido.
+  * @return la tabla, o 0 si el nivel no se compiló en este binario o la CPU no lo admite.
+  */
+const KernelTable * KernelsForTier (CpuTier tier);
+
+/**
+  * @brief Nombre de un nivel, tal como se usa en IMAGE_CPU_TIER.
+  */
+const char * TierName (CpuTier tier);
+
+#endif // _IMAGE_KERNELS_H_
@@ -0,0 +1,116 @@
+/**
+ * @file imageLabel.h
+ * @brief Cabecera para el etiquetado de componentes conexas
+ */
+
+#ifndef _IMAGE_LABEL_H_
+#define _IMAGE_LABEL_H_
+
+#include <memory>
+#include <vector>
+
+#include <image.h>
+#include <bitImage.h>
+
+/**
+  @brief Vecindad usada para decidir si dos píxeles están conectados.
+**/
+enum Connectivity: unsigned char {
+    CONNECT_4 = 4,  ///< arriba, abajo, izquierda y derecha
+    CONNECT_8 = 8   ///< también las diagonales
+};
+
+/**
+  @brief Estadísticas de una componente conexa.
+**/
+struct ComponentStats {
+    long long area;     ///< Número de píxeles
+    int top, left;      ///< Esquina superior izquierda del rectángulo que la contiene
+    int bottom, right;  ///< Esquina inferior derecha (incluida) del rectángulo que la contiene
+    double row, col;    ///< Centroide
+};
+
+/**
+  @brief Imagen de etiquetas de componentes conexas, con las estadísticas de cada componente.
+
+  Se obtiene con LabelComponents(). La etiqueta de los píxeles de fondo es 0 y la de los de la
+  componente k es k, 1 <= k <= Count(). Las componentes se numeran en el orden en que aparece
+  su primer píxel al recorrer la imagen por filas, así que el resultado no depende del número
+  de hilos.
+**/
+class LabelMap {
+public:
+
+    /**
+      * @brief Constructor por defecto: mapa vacío.
+      */
+    LabelMap ();
+
+    int get_rows () const { return rows; }
+
+    int get_cols () const { return cols; }
+
+    /**
+      * @brief Etiqueta del píxel (i, j).
+      * @pre 0 <= i < get_rows() y 0 <= j < get_cols()
+      */
+    int get_label (int i, int j) const { return labels[(size_t)i * cols + j]; }
+
+    /**
+      * @brief Etiquetas de la fila @a i.
+      * @pre 0 <= i < get_rows()
+      */
+    const int * get_row (int i) const { return labels.get() + (size_t)i * cols; }
+
+    /**
+      * @brief Número de componentes.
+      */
+    int Count () const { return (int)stats.size(); }
+
+    /**
+      * @brief Estadísticas de la componente @a label.
+      * @pre 1 <= label <= Count()
+      */
+    const ComponentStats & Stats (int label) const { return stats[label - 1]; }
+
+    /**
+      * @brief Máscara con los píxeles de una componente.
+      * @pre 1 <= label <= Count()
+      */
+    BitImage Mask (int label) const;
+
+private:
+
+    int rows, cols;
+    std::unique_ptr<int[]> labels;
+    std::vector<ComponentStats> stats;
+
+    template <class Source>
+    static LabelMap Label (const Source & src, Connectivity conn);
+
+    friend LabelMap LabelComponents (const Image & image, Connectivity conn);
+    friend LabelMap LabelComponents (const BitImage & mask, Connectivity conn);
+};
+
+/**
+  * @brief Etiqueta las componentes conexas de los píxeles distintos de 0 de una imagen.
+  *
+  * La imagen se reparte en bandas de filas que se etiquetan en paralelo con un union-find
+  * propio de cada banda; después se unen sin cerrojos las etiquetas que se tocan a ambos
+  * lados de las fronteras entre bandas y se renumeran y se calculan las estadísticas, también
+  * en paralelo.
+  * @param image imagen a etiquetar.
+  * @param conn vecindad.
+  * @return Devuelve el mapa de etiquetas con las estadísticas de cada componente.
+  */
+LabelMap LabelComponents (const Image & image, Connectivity conn = CONNECT_8);
+
+/**
+  * @brief Etiqueta las componentes conexas de los píxeles a 1 de una máscara.
+  * @param mask máscara a etiquetar.
+  * @param conn vecindad.
+  * @return Devuelve el mapa de etiquetas con las estadísticas de cada componente.
+  */
+LabelMap LabelComponents (const BitImage & mask, Connectivity conn = CONNECT_8);
+
+#endif // _IMAGE_LABEL_H_
@@ -0,0 +1,125 @@
+/**
+ * @file imageLoader.h
+ * @brief Cabecera para la carga anticipada y el guardado asíncrono de imágenes
+ */
+
+#ifndef _IMAGE_LOADER_H_
+#define _IMAGE_LOADER_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include <image.h>
+
+/**
+  @brief Resultado de cargar un fichero con ImageLoader.
+**/
+struct LoadedImage {
+    std::string path;  ///< Ruta del fichero
+    Image image;       ///< Imagen leída; vacía si la lectura falló
+    bool ok;           ///< Si la lectura tuvo éxito
+};
+
+/**
+  @brief Cargador de imágenes con lectura anticipada.
+
+  Recibe una lista de rutas y va leyendo y decodificando hasta @a prefetch ficheros por delante
+  del consumidor, de modo que el disco trabaja mientras se procesa la imagen anterior. Las
+  imágenes se entregan con Next() en el mismo orden que la lista.
+
+  Hay dos formas de lectura, elegidas al compilar:
+  - io_uring (si la biblioteca se compiló con la opción IMAGE_IO_URING, que necesita liburing):
+    un hilo envía las lecturas de toda la ventana al núcleo en un solo lote y los hilos de
+    trabajo decodifican con Image::LoadFromMemory.
+  - hilos (por defecto): cada hilo de trabajo lee y decodifica un fichero con Image::Load.
+
+  SaveAsync() encola el guardado de una imagen en los mismos hilos, que atienden antes los
+  guardados que las lecturas para no acumular imágenes en memoria.
+
+  Uso típico:
+
+  \code
+  ImageLoader loader(paths, 8);
+  LoadedImage item;
+  while (loader.Next(item))
+      if (item.ok){
+          item.image.AdjustContrast(64, 192, 32, 224);
+          loader.SaveAsync(item.image, item.path + ".out.pgm");
+      }
+  \endcode
+**/
+class ImageLoader {
+public:
+
+    /**
+      * @brief Constructor. Empieza a leer de inmediato.
+      * @param paths rutas de las imágenes, en el orden en que se consumirán.
+      * @param prefetch número máximo de imágenes leídas y aún no consumidas.
+      * @param nthreads hilos de trabajo. Por defecto, @a prefetch.
+      */
+    ImageLoader (const std::vector<std::string> & paths, int prefetch = 4, int nthreads = 0);
+
+    /**
+      * @brief Destructor. Espera a que terminen los guardados pendientes.
+      */
+    ~ImageLoader ();
+
+    /**
+      * @brief Entrega la siguiente imagen de la lista, esperando a que esté leída.
+      * @param item Parámetro de salida con la ruta, la imagen y el resultado de la lectura.
+      * @return false cuando ya se han entregado todas las imágenes.
+      */
+    bool Next (LoadedImage & item);
+
+    /**
+      * @brief Encola el guardado de una imagen.
+      * @param image imagen a guardar; se guarda una copia.
+      * @param path ruta de destino; el formato se elige como en Image::Save.
+      * @return futuro con el resultado de Image::Save.
+      */
+    std::future<bool> SaveAsync (const Image & image, const std::string & path);
+
+    /**
+      * @brief Nombre de la forma de lectura compilada: "io_uring" o "threads".
+      */
+    static const char * Backend ();
+
+private:
+
+    enum SlotState { EMPTY, READING, READ, DECODING, READY };
+
+    struct Slot {
+        SlotState state;
+        std::vector<unsigned char> bytes;
+        LoadedImage item;
+    };
+
+    std::vector<std::string> paths;
+    std::vector<Slot> window;   // slot de la imagen k: window[k % window.size()]
+    size_t issued;              // siguiente imagen por leer
+    size_t consumed;            // siguiente imagen por entregar
+    std::deque<size_t> decode;  // imágenes leídas pendientes de decodificar
+    std::deque<std::packaged_task<bool()> > saves;
+    bool stopping;
+    bool direct_reads;          // los hilos de trabajo leen los ficheros ellos mismos
+
+    std::mutex m;
+    std::condition_variable work;
+    std::condition_variable ready;
+    std::vector<std::thread> workers;
+    std::thread reader;
+
+    bool CanIssue () const;
+    void WorkerLoop ();
+    void ReaderLoop ();
+
+    ImageLoader (const ImageLoader &);
+    ImageLoader & operator= (const ImageLoader &);
+};
+
+#endif // _IMAGE_LOADER_H_
@@ -0,0 +1,268 @@
+/**
+ * @file imageServer.h
+ * @brief Cabecera para el servidor de operaciones sobre imágenes y su cliente
+ *
+ * El servidor atiende peticiones por un socket Unix de tipo SOCK_SEQPACKET, que conserva los
+ * límites de cada mensaje. Cada petición y cada respuesta es un solo mensaje: una cabecera de
+ * tamaño fijo seguida de los píxeles de la imagen, o, si la imagen es grande, la cabecera sola
+ * con un descriptor de un fichero en memoria (memfd) con los píxeles adjunto al mensaje.
+ *
+ * Con memfd los píxeles se copian una sola vez por petición: el cliente copia su imagen al
+ * memfd. El servidor trabaja sobre el memfd proyectado (ver Image::Wrap()); las operaciones
+ * que no cambian el tamaño lo modifican en su sitio y devuelven el mismo memfd, y las demás
+ * escriben el resultado directamente en uno nuevo. El cliente proyecta el del resultado sin
+ * copiarlo. Los memfd van sellados contra cambios de tamaño y se rechazan los que no lo están.
+ */
+
+#ifndef _IMAGE_SERVER_H_
+#define _IMAGE_SERVER_H_
+
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <image.h>
+
+/**
+  @brief Operaciones que ofrece el servidor; cada una equivale a uno de los programas.
+**/
+enum ServerOp: uint8_t {
+    OP_INVERT = 1,      ///< negativo: Invert()
+    OP_CROP,            ///< subimagen: CropView(args[0], args[1], args[2], args[3])
+    OP_ZOOM,            ///< zoom: CropView(args[0], args[1], args[2], args[2]).Zoom2X()
+    OP_SUBSAMPLE,       ///< icono: Subsample(args[0])
+    OP_CONTRAST         ///< contraste: AdjustContrast(args[0], args[1], args[2], args[3])
+};
+
+/**
+  @brief Resultado de una petición.
+**/
+enum ServerStatus: int32_t {
+    STATUS_OK = 0,          ///< la respuesta lleva la imagen resultado
+    STATUS_BAD_REQUEST,     ///< petición mal formada o con parámetros no válidos
+    STATUS_ERROR            ///< el servidor no pudo completar la operación
+};
+
+/// Número mágico de las cabeceras ("IMGS")
+const uint32_t SERVER_MAGIC = 0x53474d49;
+
+/// Los píxeles van en un memfd adjunto al mensaje en lugar de tras la cabecera
+const uint8_t PAYLOAD_MEMFD = 1;
+
+/// Imágenes de hasta este número de píxeles van en el propio mensaje: para ellas crear y
+/// proyectar un memfd cuesta más que copiarlas
+const int SERVER_INLINE_PIXELS = 16 << 10;
+
+/**
+  @brief Cabecera de una petición.
+**/
+struct ServerRequest {
+    uint32_t magic;     ///< SERVER_MAGIC
+    uint32_t id;        ///< identificador elegido por el cliente, devuelto en la respuesta
+    uint8_t op;         ///< ServerOp
+    uint8_t flags;      ///< PAYLOAD_MEMFD o 0
+    uint16_t reserved;
+    int32_t rows;       ///< dimensiones de la imagen de entrada
+    int32_t cols;
+    int32_t args[4];    ///< parámetros de la operación
+};
+
+/**
+  @brief Cabecera de una respuesta.
+**/
+struct ServerResponse {
+    uint32_t magic;     ///< SERVER_MAGIC
+    uint32_t id;        ///< el de la petición
+    int32_t status;     ///< ServerStatus
+    uint8_t flags;      ///< PAYLOAD_MEMFD o 0
+    uint8_t reserved[3];
+    int32_t rows;       ///< dimensiones del resultado, 0 si status != STATUS_OK
+    int32_t cols;
+};
+
+/**
+  @brief Servidor de operaciones sobre imágenes.
+
+  Un hilo recibe las peticiones de todas las conexiones y las encola; un grupo de hilos las
+  atiende. Las peticiones pequeñas se agrupan: un hilo que toma una del principio de la cola
+  toma también las pequeñas que la siguen, hasta SERVER_BATCH, y las atiende seguidas, con lo
+  que el reparto por la cola y los despertares se pagan una vez por grupo. Las respuestas de una
+  conexión pueden llegar en otro orden que sus peticiones; el cliente las empareja por id.
+
+  Ningún hilo se bloquea en el socket de un cliente: las respuestas que no caben en él se
+  encolan en su conexión y salen cuando el cliente las lee. Con SERVER_PENDING peticiones de una
+  conexión sin responder, el servidor deja de leer de ella hasta que su cliente recoja respuestas.
+
+  Puede integrarse en otro programa: Run() no vuelve hasta que se llama a Stop() desde otro hilo.
+
+  \code
+  ImageServer server("/tmp/imaged.sock", 4);
+  if (server.Start())
+      server.Run();
+  \endcode
+**/
+class ImageServer {
+public:
+
+    /// Peticiones pequeñas que atiende un hilo de una vez, como mucho
+    static const int SERVER_BATCH = 32;
+
+    /// Peticiones de una conexión recibidas y aún sin responder, como mucho
+    static const int SERVER_PENDING = 64;
+
+    /**
+      * @brief Constructor.
+      * @param path ruta del socket; si ya existe se sustituye.
+      * @param workers hilos que atienden peticiones. Si es menor o igual que 0, uno por núcleo.
+      */
+    ImageServer (const std::string & path, int workers = 0);
+
+    ~ImageServer ();
+
+    /**
+      * @brief Crea el socket y empieza a escuchar.
+      * @return si se pudo crear el socket.
+      */
+    bool Start ();
+
+    /**
+      * @brief Atiende peticiones hasta que se llama a Stop().
+      */
+    void Run ();
+
+    /**
+      * @brief Hace que Run() termine tras atender las peticiones ya recibidas. Las respuestas
+      * que sus clientes no hayan leído para entonces se descartan.
+      */
+    void Stop ();
+
+    /**
+      * @brief Número de peticiones atendidas.
+      */
+    uint64_t Served () const { return served; }
+
+private:
+
+    struct Connection;
+
+    struct Job {
+        std::shared_ptr<Connection> conn;
+        ServerRequest req;
+        std::vector<unsigned char> pixels;  // si van en el mensaje
+        int fd = -1;                        // memfd con los píxeles, o -1
+    };
+
+    std::string path;
+    int nworkers;
+    int listen_fd;
+    int wake_fd;        // eventfd para despertar a Run() desde Stop() o desde los hilos
+    std::atomic<bool> stopping;
+    std::atomic<uint64_t> served;
+
+    std::mutex m;
+    std::condition_variable ready;
+    std::deque<Job> queue;
+    bool done;
+
+    void Work ();
+    void Serve (Job & job);
+    void Wake ();
+
+    ImageServer (const ImageServer &);
+    ImageServer & operator= (const ImageServer &);
+};
+
+/**
+  @brief Cliente del servidor de operaciones sobre imágenes.
+
+  Cada objeto abre su propia conexión y no debe usarse desde varios hilos a la vez; para
+  peticiones concurrentes, un cliente por hilo.
+
+  \code
+  ImageClient client;
+  Image icon;
+  if (client.Connect("/tmp/imaged.sock") && client.Subsample(image, 8, icon))
+      icon.Save("icono.pgm");
+  \endcode
+**/
+class ImageClient {
+public:
+    ImageClient ();
+    ~ImageClient ();
+
+    /**
+      * @brief Conecta con un servidor.
+      * @param path ruta del socket del servidor.
+      * @return si se pudo conectar.
+      */
+    bool Connect (const std::string & path);
+
+    /**
+      * @brief Cierra la conexión.
+      */
+    void Close ();
+
+    /**
+      * @brief Envía una petición sin esperar la respuesta.
+      * @param op operación.
+      * @param in imagen de entrada.
+      * @param args parámetros de la operación (ver ServerOp).
+      * @return identificador de la petición, para Receive(); 0 si no pudo enviarse.
+      */
+    uint32_t Send (ServerOp op, const Image & in, const int args[4]);
+
+    /**
+      * @brief Recibe la siguiente respuesta, sea de la petición que sea.
+      * @param id Parámetro de salida con el identificador de la petición respondida.
+      * @param out Parámetro de salida con el resultado. Si llegó en un memfd, @a out usa
+      * directamente su proyección.
+      * @return el estado de la respuesta; STATUS_ERROR si se perdió la conexión.
+      */
+    ServerStatus Receive (uint32_t & id, Image & out);
+
+    /**
+      * @brief Envía una petición y espera su respuesta.
+      * @return si la operación tuvo éxito.
+      */
+    bool Call (ServerOp op, const Image & in, const int args[4], Image & out);
+
+    bool Invert (const Image & in, Image & out) {
+        const int args[4] = { 0, 0, 0, 0 };
+        return Call(OP_INVERT, in, args, out);
+    }
+
+    bool Crop (const Image & in, int nrow, int ncol, int height, int width, Image & out) {
+        const int args[4] = { nrow, ncol, height, width };
+        return Call(OP_CROP, in, args, out);
+    }
+
+    bool Zoom (const Image & in, int row, int col, int size, Image & out) {
+        const int args[4] = { row, col, size, 0 };
+        return Call(OP_ZOOM, in, args, out);
+    }
+
+    bool Subsample (const Image & in, int factor, Image & out) {
+        const int args[4] = { factor, 0, 0, 0 };
+        return Call(OP_SUBSAMPLE, in, args, out);
+    }
+
+    bool AdjustContrast (const Image & in, byte in1, byte in2, byte out1, byte out2, Image & out) {
+        const int args[4] = { in1, in2, out1, out2 };
+        return Call(OP_CONTRAST, in, args, out);
+    }
+
+private:
+    int fd;
+    uint32_t next_id;
+
+    ImageClient (const ImageClient &);
+    ImageClient & operator= (const ImageClient &);
+};
+
+#endif // _IMAGE_SERVER_H_
@@ -0,0 +1,176 @@
+/**
+ * @file imageTransform.h
+ * @brief Recorridos genéricos de imágenes por filas, resueltos en tiempo de compilación
+ *
+ * Las operaciones píxel a píxel se escriben como un functor (normalmente una lambda) que se
+ * pasa a ForEachPixel, Transform o TransformNeighborhood. Como el functor, el tipo de píxel y
+ * la política de borde son parámetros de plantilla, el compilador integra el functor en el
+ * bucle interior, que recorre punteros a fila y puede vectorizar.
+ *
+ * \code
+ * Transform(MakeView(src), MakeView(dst), [](byte p) { return (byte)(255 - p); });
+ * TransformNeighborhood<BorderClamp>(MakeView(src), MakeView(dst), 1, [](const auto & w) {
+ *     return (byte)((w(-1, 0) + w(1, 0) + w(0, -1) + w(0, 1) + 2) / 4);
+ * });
+ * \endcode
+ */
+
+#ifndef _IMAGE_TRANSFORM_H_
+#define _IMAGE_TRANSFORM_H_
+
+#include <image.h>
+
+/**
+  @brief Vista sobre los punteros a fila de una imagen de píxeles de tipo @a Pixel.
+**/
+template <class Pixel>
+struct RowView {
+    Pixel * const * rows;  ///< Punteros a cada fila
+    int nrows;             ///< Número de filas
+    int ncols;             ///< Número de columnas
+
+    Pixel * operator[] (int i) const { return rows[i]; }
+};
+
+/// Vista de solo lectura de una imagen
+inline RowView<const byte> MakeView (const Image & image){
+    RowView<const byte> v = { image.get_row_table(), image.get_rows(), image.get_cols() };
+    return v;
+}
+
+/// Vista de escritura de una imagen
+inline RowView<byte> MakeView (Image & image){
+    RowView<byte> v = { image.get_row_table(), image.get_rows(), image.get_cols() };
+    return v;
+}
+
+/**
+  @brief Política de borde: repite el píxel más cercano del borde.
+**/
+struct BorderClamp {
+    static bool Inside (int, int) { return true; }
+    static int Index (int i, int n) { return i < 0 ? 0 : (i >= n ? n - 1 : i); }
+};
+
+/**
+  @brief Política de borde: refleja la imagen sobre su borde (dcb|abcd|cba).
+**/
+struct BorderReflect {
+    static bool Inside (int, int) { return true; }
+    static int Index (int i, int n){
+        if (n == 1)
+            return 0;
+        int period = 2 * (n - 1);
+        i %= period;
+        if (i < 0)
+            i += period;
+        return i < n ? i : period - i;
+    }
+};
+
+/**
+  @brief Política de borde: la imagen se repite periódicamente.
+**/
+struct BorderWrap {
+    static bool Inside (int, int) { return true; }
+    static int Index (int i, int n){
+        i %= n;
+        return i < 0 ? i + n : i;
+    }
+};
+
+/**
+  @brief Política de borde: fuera de la imagen los píxeles valen 0.
+**/
+struct BorderZero {
+    static bool Inside (int i, int n) { return i >= 0 && i < n; }
+    static int Index (int i, int) { return i; }
+};
+
+/**
+  @brief Ventana alrededor de un píxel; w(di, dj) es el píxel desplazado (di, dj).
+
+  En el interior de la imagen (@a Checked == false) no se comprueban los bordes.
+**/
+template <class Pixel, class Border, bool Checked>
+struct Neighborhood {
+    const RowView<Pixel> & src;
+    int i, j;
+
+    Pixel operator() (int di, int dj) const {
+        int r = i + di, c = j + dj;
+        if (!Checked)
+            return src.rows[r][c];
+        if (!Border::Inside(r, src.nrows) || !Border::Inside(c, src.ncols))
+            return Pixel();
+        return src.rows[Border::Index(r, src.nrows)][Border::Index(c, src.ncols)];
+    }
+};
+
+/**
+  * @brief Aplica @a f a cada píxel de la vista, modificándolo en su sitio.
+  * @param v vista a recorrer.
+  * @param f functor llamado como f(Pixel &).
+  */
+template <class Pixel, class F>
+inline void ForEachPixel (const RowView<Pixel> & v, F f){
+    for (int i = 0; i < v.nrows; ++i){
+        Pixel * row = v.rows[i];
+        for (int j = 0; j < v.ncols; ++j)
+            f(row[j]);
+    }
+}
+
+/**
+  * @brief Escribe en cada píxel de @a dst el resultado de @a f sobre el píxel de @a src.
+  * @param src vista de origen.
+  * @param dst vista de destino, de las mismas dimensiones. Puede ser la misma que @a src.
+  * @param f functor llamado como f(SrcPixel) y que devuelve un DstPixel.
+  */
+template <class SrcPixel, class DstPixel, class F>
+inline void Transform (const RowView<SrcPixel> & src, const RowView<DstPixel> & dst, F f){
+    for (int i = 0; i < src.nrows; ++i){
+        const SrcPixel * in = src.rows[i];
+        DstPixel * out = dst.rows[i];
+        for (int j = 0; j < src.ncols; ++j)
+            out[j] = f(in[j]);
+    }
+}
+
+/**
+  * @brief Escribe en cada píxel de @a dst el resultado de @a f sobre la ventana del píxel en @a src.
+  *
+  * Las filas y columnas a menos de @a radius del borde usan la política @a Border; el resto
+  * accede a los píxeles sin comprobaciones.
+  * @param src vista de origen.
+  * @param dst vista de destino, de las mismas dimensiones y distinta de @a src.
+  * @param radius mayor desplazamiento que pedirá @a f en cada dirección.
+  * @param f functor llamado como f(w), con w una Neighborhood<SrcPixel, Border, Checked>;
+  * normalmente una lambda genérica.
+  */
+template <class Border, class SrcPixel, class DstPixel, class F>
+void TransformNeighborhood (const RowView<SrcPixel> & src, const RowView<DstPixel> & dst, int radius, F f){
+    for (int i = 0; i < src.nrows; ++i){
+        DstPixel * out = dst.rows[i];
+        bool row_inside = i >= radius && i < src.nrows - radius;
+        Neighborhood<SrcPixel, Border, true> edge = { src, i, 0 };
+        Neighborhood<SrcPixel, Border, false> inner = { src, i, 0 };
+        int j = 0;
+        if (row_inside){
+            for (; j < radius && j < src.ncols; ++j){
+                edge.j = j;
+                out[j] = f(edge);
+            }
+            for (; j < src.ncols - radius; ++j){
+                inner.j = j;
+                out[j] = f(inner);
+            }
+        }
+        for (; j < src.ncols; ++j){
+            edge.j = j;
+            out[j] = f(edge);
+        }
+    }
+}
+
+#endif // _IMAGE_TRANSFORM_H_
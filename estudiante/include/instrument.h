@@ -0,0 +1,125 @@
+/**
+ * @file instrument.h
+ * @brief Cabecera para la instrumentación de las operaciones de la biblioteca
+ *
+ * Con la opción de CMake IMAGE_INSTRUMENTATION activada, cada operación marcada con
+ * IMAGE_PROFILE_SCOPE acumula, por hilo, el número de llamadas, el tiempo real, los píxeles
+ * procesados, los bytes reservados y los bytes de E/S, y deja un evento en una traza.
+ * Con la opción desactivada (por defecto) las macros no generan código.
+ *
+ * Los resultados se vuelcan con ProfileDumpJSON() y ProfileDumpTrace() (formato de eventos
+ * de Chrome, visible en chrome://tracing o Perfetto), o al terminar el programa si están
+ * definidas las variables de entorno IMAGE_PROFILE_JSON o IMAGE_PROFILE_TRACE con la ruta
+ * del fichero de salida.
+ */
+
+#ifndef _INSTRUMENT_H_
+#define _INSTRUMENT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+  @brief Contadores acumulados de una operación, sumados sobre todos los hilos.
+**/
+struct ProfileStats {
+    const char *name;       ///< Nombre de la operación
+    uint64_t calls;         ///< Número de llamadas
+    uint64_t nanos;         ///< Tiempo real acumulado (incluye operaciones anidadas)
+    uint64_t pixels;        ///< Píxeles procesados
+    uint64_t alloc_bytes;   ///< Bytes reservados dentro de la operación
+    uint64_t io_bytes;      ///< Bytes leídos o escritos dentro de la operación
+};
+
+/**
+  * @brief Registra una operación y devuelve su identificador.
+  * @param name nombre de la operación; debe ser una cadena constante.
+  */
+int ProfileRegister (const char *name);
+
+/**
+  @brief Mide una llamada a una operación desde su construcción hasta su destrucción.
+
+  Las reservas y la E/S que ocurren mientras está activa se atribuyen a la medición más interna
+  del hilo.
+**/
+class ProfileScope {
+public:
+    explicit ProfileScope (int op);
+    ~ProfileScope ();
+
+    void AddPixels (uint64_t n) { pixels += n; }
+    void AddAllocated (uint64_t n) { alloc_bytes += n; }
+    void AddIO (uint64_t n) { io_bytes += n; }
+
+private:
+    int op;
+    uint64_t start;
+    uint64_t pixels, alloc_bytes, io_bytes;
+    ProfileScope *parent;
+
+    ProfileScope (const ProfileScope &);
+    ProfileScope & operator= (const ProfileScope &);
+};
+
+/**
+  * @brief Atribuye una reserva de memoria a la operación activa del hilo, si la hay.
+  */
+void ProfileAddAllocated (size_t bytes);
+
+/**
+  * @brief Atribuye bytes de E/S a la operación activa del hilo, si la hay.
+  */
+void ProfileAddIO (size_t bytes);
+
+/**
+  * @brief Contadores actuales de todas las operaciones registradas.
+  */
+std::vector<ProfileStats> ProfileSnapshot ();
+
+/**
+  * @brief Pone a cero los contadores y descarta los eventos de la traza.
+  */
+void ProfileReset ();
+
+/**
+  * @brief Vuelca los contadores de cada operación en formato JSON.
+  * @param path fichero de salida.
+  * @return si se pudo escribir el fichero.
+  */
+bool ProfileDumpJSON (const char *path);
+
+/**
+  * @brief Vuelca la traza de llamadas en el formato de eventos de Chrome.
+  * @param path fichero de salida.
+  * @return si se pudo escribir el fichero.
+  */
+bool ProfileDumpTrace (const char *path);
+
+#ifdef IMAGE_INSTRUMENTATION
+
+/// Mide el resto del bloque como una llamada a la operación @a name
+#define IMAGE_PROFILE_SCOPE(name) \
+    static const int image_profile_op_ = ProfileRegister(name); \
+    ProfileScope image_profile_scope_(image_profile_op_)
+
+/// Suma @a n píxeles procesados a la medición declarada con IMAGE_PROFILE_SCOPE en el bloque
+#define IMAGE_PROFILE_PIXELS(n) image_profile_scope_.AddPixels(n)
+
+/// Atribuye @a n bytes reservados a la operación activa del hilo
+#define IMAGE_PROFILE_ALLOC(n) ProfileAddAllocated(n)
+
+/// Atribuye @a n bytes de E/S a la operación activa del hilo
+#define IMAGE_PROFILE_IO(n) ProfileAddIO(n)
+
+#else
+
+#define IMAGE_PROFILE_SCOPE(name) ((void)0)
+#define IMAGE_PROFILE_PIXELS(n) ((void)0)
+#define IMAGE_PROFILE_ALLOC(n) ((void)0)
+#define IMAGE_PROFILE_IO(n) ((void)0)
+
+#endif
+
+#endif // _INSTRUMENT_H_
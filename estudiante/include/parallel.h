@@ -0,0 +1,64 @@
+/**
+ * @file parallel.h
+ * @brief Utilidades para repartir el trabajo de la biblioteca entre varios hilos
+ *
+ * Las operaciones paralelas de la biblioteca dividen su dominio (filas, tiras, ficheros...)
+ * en bandas contiguas y procesan cada banda en un hilo distinto.
+ */
+
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <thread>
+#include <vector>
+
+/**
+  * @brief Número de hilos que usan las operaciones paralelas de la biblioteca.
+  *
+  * Por defecto es el número de núcleos disponibles. Puede fijarse con la variable de entorno
+  * IMAGE_THREADS o con SetNumThreads().
+  * @return número de hilos, siempre mayor que 0.
+  */
+int GetNumThreads();
+
+/**
+  * @brief Fija el número de hilos que usan las operaciones paralelas de la biblioteca.
+  * @param nthreads número de hilos. Si es menor o igual que 0 se vuelve al valor por defecto.
+  */
+void SetNumThreads(int nthreads);
+
+/**
+  * @brief Ejecuta @a body sobre el intervalo [0, n) repartido en bandas contiguas.
+  * @param n tamaño del dominio.
+  * @param body función llamada como body(inicio, fin) una vez por banda.
+  * @param grain tamaño mínimo de banda; evita lanzar hilos para dominios pequeños.
+  * @post Todas las bandas han terminado al volver. La banda 0 se ejecuta en el hilo llamante.
+  */
+template <class Body>
+void ParallelFor(int n, Body body, int grain = 1){
+    if (n <= 0)
+        return;
+    if (grain < 1)
+        grain = 1;
+
+    int nthreads = GetNumThreads();
+    if (nthreads > n / grain)
+        nthreads = n / grain;
+    if (nthreads <= 1){
+        body(0, n);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(nthreads - 1);
+    for (int t = 1; t < nthreads; ++t){
+        int begin = (int)((long long)n * t / nthreads);
+        int end = (int)((long long)n * (t + 1) / nthreads);
+        workers.emplace_back([=]() { body(begin, end); });
+    }
+    body(0, (int)((long long)n / nthreads));
+    for (std::thread & w : workers)
+        w.join();
+}
+
+#endif // _PARALLEL_H_
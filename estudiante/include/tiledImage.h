@@ -0,0 +1,169 @@
+/**
+ * @file tiledImage.h
+ * @brief Cabecera para la clase TiledImage, imágenes mayores que la memoria disponible
+ */
+
+#ifndef _TILED_IMAGE_H_
+#define _TILED_IMAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <image.h>
+
+/**
+  @brief Estadísticas de la caché de bloques de una TiledImage.
+**/
+struct TileCacheStats {
+    uint64_t hits;      ///< Accesos a bloques que estaban en memoria
+    uint64_t misses;    ///< Accesos a bloques que no estaban en memoria
+    uint64_t reads;     ///< Bloques leídos del fichero temporal
+    uint64_t writes;    ///< Bloques modificados escritos al fichero temporal al expulsarlos
+    size_t frames;      ///< Bloques que caben en memoria
+};
+
+/**
+  @brief Imagen de grises guardada por bloques en un fichero temporal.
+
+  Pensada para imágenes que no caben en memoria, como panorámicas de varios gigapíxeles. Los
+  píxeles se dividen en bloques de TILE_SIZE x TILE_SIZE que se guardan en un fichero temporal
+  (borrado desde su creación, así que desaparece al cerrarse aunque el programa termine mal) y
+  se traen a memoria cuando se usan. En memoria se mantienen como mucho los bloques que caben
+  en el presupuesto, expulsando los usados hace más tiempo y escribiendo los modificados.
+
+  Ofrece las operaciones de Image que tienen sentido sobre imágenes enormes: las que la
+  recorren entera (AdjustContrast()) o producen un resultado pequeño (Crop(), Subsample()).
+  Cada operación recorre los bloques en el orden que le conviene e indica si volverá a usarlos:
+  los que solo se visitan una vez se expulsan antes que el resto, para que una pasada completa
+  no desaloje los bloques que sí se reutilizan, y el siguiente bloque del recorrido se pide al
+  sistema por adelantado.
+
+  Los bloques se reparten entre los hilos (ver SetNumThreads()), y cada hilo lee y escribe sus
+  bloques del fichero temporal sin bloquear a los demás.
+
+  Uso típico:
+
+  \code
+  TiledImage huge(512 << 20);
+  huge.Load("panoramica.pgm");
+  huge.AdjustContrast(30, 220, 0, 255);
+  huge.Subsample(16).Save("icono.pgm");
+  \endcode
+**/
+class TiledImage {
+public:
+
+    /// Lado de los bloques, en píxeles
+    static const int TILE_SIZE = 256;
+
+    /**
+      * @brief Constructor de una imagen vacía.
+      * @param budget bytes de memoria para bloques. Se redondea hacia arriba para que quepa al
+      * menos un bloque por hilo.
+      * @param scratch_dir directorio del fichero temporal; si está vacío se usa el de la
+      * variable de entorno TMPDIR o, si no está, /tmp.
+      */
+    explicit TiledImage (size_t budget = 256 << 20, const std::string & scratch_dir = "");
+
+    /**
+      * @brief Constructor de una imagen con todos los píxeles a 0.
+      * @param rows filas de la imagen.
+      * @param cols columnas de la imagen.
+      * @param budget bytes de memoria para bloques.
+      * @param scratch_dir directorio del fichero temporal.
+      * @post Si no pudo crearse el fichero temporal la imagen queda vacía y Good() es false.
+      */
+    TiledImage (int rows, int cols, size_t budget = 256 << 20, const std::string & scratch_dir = "");
+
+    ~TiledImage ();
+
+    /**
+      * @brief Lee una imagen PGM, proyectando el fichero en memoria en lugar de leerlo entero.
+      * @param path fichero a leer.
+      * @return si se pudo leer. Solo se admite PGM: PGZ exigiría descomprimirlo entero.
+      */
+    bool Load (const char * path);
+
+    /**
+      * @brief Guarda la imagen como PGM, por franjas de TILE_SIZE filas.
+      * @param path fichero a escribir.
+      * @return si se pudo escribir.
+      */
+    bool Save (const char * path) const;
+
+    int get_rows () const { return rows; }
+    int get_cols () const { return cols; }
+
+    /**
+      * @brief Indica si todas las lecturas y escrituras del fichero temporal han tenido éxito.
+      *
+      * Si alguna falla, los bloques afectados se leen como 0 y Good() pasa a ser false.
+      */
+    bool Good () const;
+
+    /**
+      * @brief Valor de un píxel. Trae su bloque a memoria si no estaba.
+      * @pre 0 <= i < rows, 0 <= j < cols
+      */
+    byte get_pixel (int i, int j) const;
+
+    /**
+      * @brief Asigna el valor de un píxel.
+      * @pre 0 <= i < rows, 0 <= j < cols
+      */
+    void set_pixel (int i, int j, byte value);
+
+    /**
+      * @brief Copia una imagen sobre esta, como Image::PaintIn().
+      * @param in imagen que se pinta.
+      * @param i fila donde se sitúa la esquina superior izquierda de @a in.
+      * @param j columna donde se sitúa la esquina superior izquierda de @a in.
+      * @post Los píxeles de @a in que quedan fuera se descartan.
+      */
+    void PaintIn (const Image & in, int i, int j);
+
+    /**
+      * @brief Genera una subimagen en memoria, como Image::Crop().
+      * @return Devuelve el recorte, con 0 en la parte que cae fuera de la imagen.
+      */
+    Image Crop (int nrow, int ncol, int height, int width) const;
+
+    /**
+      * @brief Genera una reducción en memoria, como Image::Subsample().
+      * @pre factor > 0
+      * @return Devuelve la misma imagen que Image::Subsample() sobre la imagen completa.
+      */
+    Image Subsample (int factor, bool partial = false) const;
+
+    /**
+      * @brief Ajuste de contraste, como Image::AdjustContrast().
+      */
+    void AdjustContrast (byte in1, byte in2, byte out1, byte out2);
+
+    /**
+      * @brief Estadísticas acumuladas de la caché de bloques.
+      */
+    TileCacheStats Stats () const;
+
+private:
+
+    struct Cache;
+
+    int rows, cols;
+    int tile_rows, tile_cols;   // filas y columnas de bloques
+    size_t budget;
+    std::string dir;
+    std::unique_ptr<Cache> cache;
+
+    bool Reset (int rows, int cols);
+
+    template <class F>
+    void ForEachTile (int r0, int c0, int r1, int c1, int mode, bool once, F fn) const;
+
+    TiledImage (const TiledImage &);
+    TiledImage & operator= (const TiledImage &);
+};
+
+#endif // _TILED_IMAGE_H_
@@ -0,0 +1,262 @@
+/**
+ * @file bitImage.cpp
+ * @brief Fichero con definiciones para la clase BitImage
+ *
+ * La erosión y la dilatación son separables como las de Image: primero la combinación de los
+ * desplazamientos horizontales de cada fila y después la de las filas vecinas. Cada paso es un
+ * AND u OR de palabras, así que cuesta w / 64 operaciones por píxel para una ventana de lado w.
+ */
+
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include <bitImage.h>
+#include <imageIO.h>
+#include <imageKernels.h>
+#include <instrument.h>
+#include <parallel.h>
+
+namespace {
+
+const uint64_t ONES = ~(uint64_t)0;
+
+// Filas de cada banda al repartir filas de n palabras entre hilos
+int WordGrain (int n) {
+    return std::max(1, (1 << 13) / std::max(n, 1));
+}
+
+// Máscara de los bits válidos de la última palabra de una fila de cols píxeles
+uint64_t LastWordMask (int cols) {
+    return cols % 64 ? ((uint64_t)1 << (cols % 64)) - 1 : ONES;
+}
+
+// Pone a 1 los bits [a, b) de una fila
+void SetBits (uint64_t * row, int a, int b) {
+    for (int j = a; j < b; ) {
+        int n = std::min(b - j, 64 - j % 64);
+        uint64_t mask = n == 64 ? ONES : (((uint64_t)1 << n) - 1) << (j % 64);
+        row[j / 64] |= mask;
+        j += n;
+    }
+}
+
+/*
+ * out[j] = in[j - dx] para 0 <= j < cols, con fill donde j - dx queda fuera de la fila.
+ * @a in y @a out no pueden solaparse.
+ */
+void ShiftRow (const uint64_t * in, uint64_t * out, int words, int cols, int dx, bool fill) {
+    if (dx >= cols || -dx >= cols) {
+        std::fill(out, out + words, fill ? ONES : 0);
+    }
+    else if (dx >= 0) {
+        // Hacia columnas mayores: bits hacia los más significativos
+        const int q = dx / 64, r = dx % 64;
+        for (int w = 0; w < words; ++w) {
+            uint64_t v = w >= q ? in[w - q] << r : 0;
+            if (r && w > q)
+                v |= in[w - q - 1] >> (64 - r);
+            out[w] = v;
+        }
+        if (fill)
+            SetBits(out, 0, dx);
+    }
+    else {
+        // Los bits que entran por la derecha vienen del relleno de la fila, que está a 0
+        const int s = -dx, q = s / 64, r = s % 64;
+        for (int w = 0; w < words; ++w) {
+            uint64_t v = w + q < words ? in[w + q] >> r : 0;
+            if (r && w + q + 1 < words)
+                v |= in[w + q + 1] << (64 - r);
+            out[w] = v;
+        }
+        if (fill)
+            SetBits(out, cols - s, cols);
+    }
+    out[words - 1] &= LastWordMask(cols);
+}
+
+// Inversión del orden de los bits de un byte
+struct ReverseTable {
+    unsigned char t[256];
+    ReverseTable () {
+        for (int v = 0; v < 256; ++v) {
+            int r = 0;
+            for (int b = 0; b < 8; ++b)
+                r |= ((v >> b) & 1) << (7 - b);
+            t[v] = (unsigned char)r;
+        }
+    }
+};
+
+const ReverseTable REVERSE;
+
+/*
+ * Erosión (AND, fuera de la imagen 1) o dilatación (OR, fuera 0) con la ventana de
+ * height x width píxeles cuya esquina superior izquierda está a (anchor_r, anchor_c) píxeles
+ * por encima y a la izquierda de cada píxel.
+ */
+BitImage Morph (const BitImage & src, int height, int width, int anchor_r, int anchor_c, bool erode) {
+    const int rows = src.get_rows(), cols = src.get_cols(), words = src.get_words();
+    BitImage tmp(rows, cols), res(rows, cols);
+    if (src.Empty())
+        return res;
+
+    ParallelFor(rows, [&](int begin, int end) {
+        std::vector<uint64_t> shifted(words);
+        for (int i = begin; i < end; ++i) {
+            const uint64_t * in = src.get_row(i);
+            uint64_t * out = tmp.get_row(i);
+            // Columnas j - anchor_c + t, 0 <= t < width: desplazamientos de anchor_c - t
+            ShiftRow(in, out, words, cols, anchor_c, erode);
+            for (int t = 1; t < width; ++t) {
+                ShiftRow(in, shifted.data(), words, cols, anchor_c - t, erode);
+                for (int w = 0; w < words; ++w)
+                    out[w] = erode ? out[w] & shifted[w] : out[w] | shifted[w];
+            }
+        }
+    }, WordGrain(words));
+
+    ParallelFor(rows, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            uint64_t * out = res.get_row(i);
+            // Las filas fuera de la imagen son el neutro: basta con combinar las de dentro
+            const int r0 = std::max(0, i - anchor_r), r1 = std::min(rows, i - anchor_r + height);
+            memcpy(out, tmp.get_row(r0), words * sizeof(uint64_t));
+            for (int r = r0 + 1; r < r1; ++r) {
+                const uint64_t * in = tmp.get_row(r);
+                for (int w = 0; w < words; ++w)
+                    out[w] = erode ? out[w] & in[w] : out[w] | in[w];
+            }
+        }
+    }, WordGrain(words));
+    return res;
+}
+
+}
+
+// _____________________________________________________________________________
+
+BitImage::BitImage () : rows(0), cols(0), words(0) {}
+
+BitImage::BitImage (int nrows, int ncols, bool value)
+    : rows(nrows > 0 && ncols > 0 ? nrows : 0), cols(rows > 0 ? ncols : 0), words((cols + 63) / 64),
+      bits((size_t)rows * words, value ? ONES : 0) {
+    if (value)
+        ClearPadding();
+}
+
+BitImage::BitImage (const Image & image, byte t) : BitImage(image.ThresholdBits(t)) {}
+
+void BitImage::ClearPadding () {
+    const uint64_t mask = LastWordMask(cols);
+    for (int i = 0; i < rows; ++i)
+        get_row(i)[words - 1] &= mask;
+}
+
+Image BitImage::ToImage (byte off, byte on) const {
+    Image res(rows, cols);
+    for (int i = 0; i < rows; ++i) {
+        const uint64_t * in = get_row(i);
+        byte * out = res.get_row(i);
+        for (int j = 0; j < cols; ++j)
+            out[j] = (in[j / 64] >> (j % 64)) & 1 ? on : off;
+    }
+    return res;
+}
+
+// _____________________________________________________________________________
+
+bool BitImage::Load (const char * file_path) {
+    IMAGE_PROFILE_SCOPE("BitImage::Load");
+    *this = BitImage();
+    int nrows, ncols;
+    unsigned char * data = ReadPBMImage(file_path, nrows, ncols);
+    if (!data)
+        return false;
+
+    *this = BitImage(nrows, ncols);
+    const int row_bytes = PBMRowBytes(cols);
+    for (int i = 0; i < rows; ++i) {
+        // En PBM el primer píxel es el bit más significativo de cada byte y el 1 es negro
+        const unsigned char * in = data + (size_t)i * row_bytes;
+        uint64_t * out = get_row(i);
+        for (int b = 0; b < row_bytes; ++b)
+            out[b / 8] |= (uint64_t)REVERSE.t[(unsigned char)~in[b]] << (8 * (b % 8));
+    }
+    ClearPadding();
+    delete [] data;
+    IMAGE_PROFILE_PIXELS((long long)rows * cols);
+    return true;
+}
+
+bool BitImage::Save (const char * file_path) const {
+    IMAGE_PROFILE_SCOPE("BitImage::Save");
+    IMAGE_PROFILE_PIXELS((long long)rows * cols);
+    const int row_bytes = PBMRowBytes(cols);
+    std::vector<unsigned char> data((size_t)rows * row_bytes);
+    // Los bits que sobran del último byte de cada fila quedan a 0
+    const unsigned char last = (unsigned char)(0xFF << ((8 - cols % 8) % 8));
+    for (int i = 0; i < rows; ++i) {
+        const uint64_t * in = get_row(i);
+        unsigned char * out = &data[(size_t)i * row_bytes];
+        for (int b = 0; b < row_bytes; ++b)
+            out[b] = (unsigned char)~REVERSE.t[(in[b / 8] >> (8 * (b % 8))) & 0xFF];
+        out[row_bytes - 1] &= last;
+    }
+    return WritePBMImage(file_path, data.data(), rows, cols);
+}
+
+// _____________________________________________________________________________
+
+long long BitImage::Count () const {
+    return Kernels().popcount(bits.data(), (int)bits.size());
+}
+
+void BitImage::Invert () {
+    for (uint64_t & w : bits)
+        w = ~w;
+    ClearPadding();
+}
+
+BitImage & BitImage::operator&= (const BitImage & other) {
+    const uint64_t * b = other.bits.data();
+    for (size_t k = 0; k < bits.size(); ++k)
+        bits[k] &= b[k];
+    return *this;
+}
+
+BitImage & BitImage::operator|= (const BitImage & other) {
+    const uint64_t * b = other.bits.data();
+    for (size_t k = 0; k < bits.size(); ++k)
+        bits[k] |= b[k];
+    return *this;
+}
+
+BitImage & BitImage::operator^= (const BitImage & other) {
+    const uint64_t * b = other.bits.data();
+    for (size_t k = 0; k < bits.size(); ++k)
+        bits[k] ^= b[k];
+    return *this;
+}
+
+// _____________________________________________________________________________
+
+BitImage BitImage::Shift (int dy, int dx, bool fill) const {
+    BitImage res(rows, cols, fill);
+    for (int i = std::max(0, dy); i < std::min(rows, rows + dy); ++i)
+        ShiftRow(get_row(i - dy), res.get_row(i), words, cols, dx, fill);
+    return res;
+}
+
+BitImage BitImage::Erode (int height, int width) const {
+    IMAGE_PROFILE_SCOPE("BitImage::Erode");
+    IMAGE_PROFILE_PIXELS((long long)rows * cols);
+    return Morph(*this, height, width, height / 2, width / 2, true);
+}
+
+BitImage BitImage::Dilate (int height, int width) const {
+    IMAGE_PROFILE_SCOPE("BitImage::Dilate");
+    IMAGE_PROFILE_PIXELS((long long)rows * cols);
+    return Morph(*this, height, width, height - 1 - height / 2, width - 1 - width / 2, false);
+}
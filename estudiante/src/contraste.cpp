@@ -8,15 +8,16 @@
 #include <iostream>
 #include <cstring>
 #include <cstdlib>
+#include <utility>
 
 #include <image.h>
+#include <diskCache.h>
 
 using namespace std;
 
 int main (int argc, char *argv[]){
 
     char *origen, *destino; // nombres de los ficheros
-    Image image;
 
     // Comprobar validez de la llamada
     if (argc != 7){
@@ -34,24 +35,35 @@ int main (int argc, char *argv[]){
     cout << "Fichero origen: " << origen << endl;
     cout << "Fichero resultado: " << destino << endl;
 
-    // Leer la imagen del fichero de entrada
-    if (!image.Load(origen)){
+    // El fichero se lee una sola vez: sirve para buscar el resultado en la cache de resultados y,
+    // si no estaba, para calcularlo
+    byte e1 = atoi(argv[3]), e2 = atoi(argv[4]), s1 = atoi(argv[5]), s2 = atoi(argv[6]);
+    DiskCache cache(DiskCache::DirFromEnvironment());
+    string op = "AdjustContrast(" + to_string(e1) + "," + to_string(e2) + "," + to_string(s1) + "," + to_string(s2) + ")";
+    bool computed = false;
+    Image result;
+    auto adjust = [&](Image & image) {
+        computed = true;
+
+        // Mostrar los parametros de la Imagen
+        cout << endl;
+        cout << "Dimensiones de " << origen << ":" << endl;
+        cout << "   Imagen   = " << image.get_rows()  << " filas x " << image.get_cols() << " columnas " << endl;
+
+        // Cambia el contraste sobre la propia imagen leida, que no se vuelve a usar
+        image.AdjustContrast(e1, e2, s1, s2);
+        return move(image);
+    };
+    if (!cache.Derive(origen, op, adjust, result)){
         cerr << "Error: No pudo leerse la imagen." << endl;
         cerr << "Terminando la ejecucion del programa." << endl;
         return 1;
     }
-
-    // Mostrar los parametros de la Imagen
-    cout << endl;
-    cout << "Dimensiones de " << origen << ":" << endl;
-    cout << "   Imagen   = " << image.get_rows()  << " filas x " << image.get_cols() << " columnas " << endl;
-
-    // Cambia el contraste
-    byte e1 = atoi(argv[3]), e2 = atoi(argv[4]), s1 = atoi(argv[5]), s2 = atoi(argv[6]);
-    image.AdjustContrast(e1, e2, s1, s2);
+    if (!computed)
+        cout << "Resultado tomado de la cache" << endl;
 
     // Guardar la imagen resultado en el fichero
-    if (image.Save(destino))
+    if (result.Save(destino))
         cout  << "La imagen se guardo en " << destino << endl;
     else{
         cerr << "Error: No pudo guardarse la imagen." << endl;
@@ -0,0 +1,184 @@
+/**
+ * @file diskCache.cpp
+ * @brief Fichero con definiciones para la caché en disco de resultados
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <thread>
+#include <functional>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <diskCache.h>
+
+using namespace std;
+
+namespace {
+
+// Versión del formato de las claves; cambiarla invalida todos los resultados guardados
+const char * const CACHE_VERSION = "diskcache-1";
+
+const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t Rotl (uint64_t x, int r){
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t Read64 (const unsigned char * p){
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint32_t Read32 (const unsigned char * p){
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint64_t Round (uint64_t acc, uint64_t input){
+    acc += input * PRIME2;
+    return Rotl(acc, 31) * PRIME1;
+}
+
+inline uint64_t MergeRound (uint64_t acc, uint64_t val){
+    acc ^= Round(0, val);
+    return acc * PRIME1 + PRIME4;
+}
+
+bool MakeDir (const string & path){
+    return mkdir(path.c_str(), 0777) == 0 || errno == EEXIST;
+}
+
+void AppendHex (string & s, uint64_t v){
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)v);
+    s += buf;
+}
+
+}
+
+// _____________________________________________________________________________
+
+uint64_t HashBytes (const void * data, size_t len, uint64_t seed){
+    const unsigned char * p = static_cast<const unsigned char *>(data);
+    const unsigned char * end = p + len;
+    uint64_t h;
+
+    // Cuatro acumuladores independientes sobre bloques de 32 bytes
+    if (len >= 32){
+        uint64_t v1 = seed + PRIME1 + PRIME2, v2 = seed + PRIME2, v3 = seed, v4 = seed - PRIME1;
+        for (; p + 32 <= end; p += 32){
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+        }
+        h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        h = MergeRound(h, v1);
+        h = MergeRound(h, v2);
+        h = MergeRound(h, v3);
+        h = MergeRound(h, v4);
+    }
+    else
+        h = seed + PRIME5;
+    h += len;
+
+    for (; p + 8 <= end; p += 8)
+        h = Rotl(h ^ Round(0, Read64(p)), 27) * PRIME1 + PRIME4;
+    if (p + 4 <= end){
+        h = Rotl(h ^ (Read32(p) * PRIME1), 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+        h = Rotl(h ^ (*p * PRIME5), 11) * PRIME1;
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+// _____________________________________________________________________________
+
+DiskCache::DiskCache (const string & dir) : dir(dir) {
+    if (!this->dir.empty() && !MakeDir(this->dir))
+        this->dir.clear();
+}
+
+string DiskCache::DirFromEnvironment (){
+    const char * env = getenv("IMAGE_CACHE_DIR");
+    return env ? env : "";
+}
+
+string DiskCache::MakeKey (const unsigned char * data, size_t len, const string & op){
+    // Hash del contenido; la operación, el tamaño y la versión se resumen con él como semilla
+    uint64_t content = HashBytes(data, len);
+    string desc = string(CACHE_VERSION) + '\0' + to_string((unsigned long long)len) + '\0' + op;
+    uint64_t params = HashBytes(desc.data(), desc.size(), content);
+
+    string key;
+    AppendHex(key, content);
+    AppendHex(key, params);
+    return key;
+}
+
+string DiskCache::EntryPath (const string & key) const {
+    return dir + "/" + key.substr(0, 2) + "/" + key.substr(2) + ".pgz";
+}
+
+// _____________________________________________________________________________
+
+bool DiskCache::Find (const char * path, const string & op, string & key, Image & image) const {
+    key.clear();
+    if (!Enabled())
+        return false;
+
+    MappedFile file;
+    if (!file.Open(path))
+        return false;
+    key = MakeKey(file.data(), file.size(), op);
+    return Lookup(key, image);
+}
+
+bool DiskCache::Lookup (const string & key, Image & image) const {
+    if (!Enabled() || key.empty())
+        return false;
+
+    string entry = EntryPath(key);
+    if (access(entry.c_str(), R_OK) != 0)
+        return false;
+    return image.Load(entry.c_str());
+}
+
+bool DiskCache::Store (const string & key, const Image & image) const {
+    if (!Enabled() || key.empty())
+        return false;
+    if (!MakeDir(dir + "/" + key.substr(0, 2)))
+        return false;
+
+    // Escribimos en un temporal propio de este hilo y lo renombramos: los lectores nunca ven un
+    // resultado a medio escribir. El temporal acaba en .pgz para que Save elija el formato.
+    string entry = EntryPath(key);
+    string tmp = entry + "." + to_string((long long)getpid()) + "-"
+               + to_string((unsigned long long)hash<thread::id>()(this_thread::get_id())) + ".tmp.pgz";
+    if (!image.Save(tmp.c_str())){
+        unlink(tmp.c_str());
+        return false;
+    }
+    if (rename(tmp.c_str(), entry.c_str()) != 0){
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
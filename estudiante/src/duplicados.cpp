@@ -0,0 +1,110 @@
+/**
+ * @file Fichero duplicados.cpp, busca imagenes casi duplicadas en un directorio
+ *
+ * Calcula en paralelo el hash perceptual de cada imagen PGM o PGZ del directorio, leyendo cada
+ * fichero proyectado en memoria, y busca los pares de hashes a poca distancia de Hamming con un
+ * HashIndex en lugar de comparar todos con todos.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+#include <dirent.h>
+
+#include <image.h>
+#include <imageHash.h>
+#include <fileIO.h>
+#include <parallel.h>
+
+using namespace std;
+
+// Indica si el nombre de fichero termina en la extension dada
+bool HasExtension(const string & name, const char *ext) {
+    size_t m = strlen(ext);
+    return name.size() >= m && strcasecmp(name.c_str() + name.size() - m, ext) == 0;
+}
+
+int main (int argc, char *argv[]){
+
+    // Comprobar validez de la llamada
+    const char *tipo = argc == 4 ? argv[3] : "dhash";
+    int distancia = argc >= 3 ? atoi(argv[2]) : 6;
+    HashKind kind = strcmp(tipo, "ahash") == 0 ? AHASH : strcmp(tipo, "phash") == 0 ? PHASH : DHASH;
+    if (argc < 2 || argc > 4 || distancia < 0 || (kind == DHASH && strcmp(tipo, "dhash") != 0)){
+        cerr << "Error: Numero incorrecto de parametros.\n";
+        cerr << "Uso: duplicados <Directorio> [distancia] [ahash|dhash|phash]\n";
+        exit (1);
+    }
+
+    // Imagenes del directorio, en orden alfabetico
+    string dir = argv[1];
+    DIR *d = opendir(dir.c_str());
+    if (!d){
+        cerr << "Error: No pudo abrirse el directorio " << dir << "." << endl;
+        return 1;
+    }
+    vector<string> paths;
+    while (struct dirent *e = readdir(d)){
+        string name = e->d_name;
+        if (HasExtension(name, ".pgm") || HasExtension(name, ".pgz"))
+            paths.push_back(dir + "/" + name);
+    }
+    closedir(d);
+    sort(paths.begin(), paths.end());
+
+    cout << endl;
+    cout << "Directorio: " << dir << " (" << paths.size() << " imagenes)" << endl;
+
+    // Cada hilo toma el siguiente fichero pendiente; el paralelismo esta entre ficheros, asi que
+    // las operaciones de cada imagen usan un solo hilo
+    vector<uint64_t> hashes(paths.size());
+    vector<char> ok(paths.size(), 0);
+    int nthreads = GetNumThreads();
+    SetNumThreads(1);
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        MappedFile file;
+        Image image;
+        size_t k;
+        while ((k = next++) < paths.size()){
+            if (!file.Open(paths[k].c_str()) || !image.LoadFromMemory(file.data(), file.size())){
+                cerr << "Aviso: No pudo leerse la imagen " << paths[k] << endl;
+                continue;
+            }
+            hashes[k] = PerceptualHash(image, kind);
+            ok[k] = 1;
+        }
+    };
+
+    vector<thread> workers;
+    for (int t = 1; t < nthreads; ++t)
+        workers.emplace_back(worker);
+    worker();
+    for (thread & t : workers)
+        t.join();
+
+    // Cada par se informa una vez, desde la imagen con el indice mayor
+    HashIndex index;
+    vector<int> found;
+    int pares = 0;
+    for (size_t k = 0; k < paths.size(); ++k){
+        if (!ok[k])
+            continue;
+        index.Query(hashes[k], distancia, found);
+        sort(found.begin(), found.end());
+        for (int j : found){
+            cout << HammingDistance(hashes[j], hashes[k]) << "\t" << paths[j] << "\t" << paths[k] << endl;
+            ++pares;
+        }
+        index.Add(hashes[k], (int)k);
+    }
+
+    cout << pares << " pares de imagenes a distancia menor o igual que " << distancia << endl;
+    return 0;
+}
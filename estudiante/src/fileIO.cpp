@@ -0,0 +1,107 @@
+/**
+  * @file fileIO.cpp
+  * @brief Fichero con definiciones para las primitivas de acceso a ficheros
+  *
+  */
+
+#include <cerrno>
+#include <climits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fileIO.h>
+
+using namespace std;
+
+bool ReadFileBytes (const char *path, vector<unsigned char> &data){
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok){
+        data.resize(st.st_size);
+        size_t done = 0;
+        while (ok && done < data.size()){
+            ssize_t r = read(fd, data.data() + done, data.size() - done);
+            if (r > 0)
+                done += r;
+            else if (r == 0 || errno != EINTR)
+                ok = false;
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+// _____________________________________________________________________________
+
+bool WriteFileBlocks (const char *path, const struct iovec *iov, int n){
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    // Copia local para poder avanzar sobre los bloques tras una escritura parcial
+    vector<struct iovec> pending(iov, iov + n);
+    struct iovec *cur = pending.data(), *end = cur + n;
+    bool ok = true;
+    while (ok && cur != end){
+        int count = end - cur < IOV_MAX ? (int)(end - cur) : IOV_MAX;
+        ssize_t w = writev(fd, cur, count);
+        if (w < 0){
+            ok = errno == EINTR;
+            continue;
+        }
+        while (cur != end && (size_t)w >= cur->iov_len){
+            w -= cur->iov_len;
+            ++cur;
+        }
+        if (cur != end){
+            cur->iov_base = static_cast<char *>(cur->iov_base) + w;
+            cur->iov_len -= w;
+        }
+    }
+    return close(fd) == 0 && ok;
+}
+
+// _____________________________________________________________________________
+
+MappedFile::MappedFile() : addr(0), length(0) {}
+
+MappedFile::~MappedFile(){
+    Close();
+}
+
+bool MappedFile::Open (const char *path){
+    Close();
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok && st.st_size > 0){
+        void *p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+            ok = false;
+        else {
+            addr = static_cast<unsigned char *>(p);
+            length = st.st_size;
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+void MappedFile::Close (){
+    if (addr)
+        munmap(addr, length);
+    addr = 0;
+    length = 0;
+}
+
+/* Fin Fichero: fileIO.cpp */
@@ -12,13 +12,13 @@
 #include <cstdlib>
 
 #include <image.h>
+#include <diskCache.h>
 
 using namespace std;
 
 int main (int argc, char *argv[]){
 
     char *origen, *destino; // nombres de los ficheros
-    Image image;
 
     // Comprobar validez de la llamada
     if (argc != 4){
@@ -36,21 +36,30 @@ int main (int argc, char *argv[]){
     cout << "Fichero origen: " << origen << endl;
     cout << "Fichero resultado: " << destino << endl;
 
-    // Leer la imagen del fichero de entrada
-    if (!image.Load(origen)){
+    // El fichero se lee una sola vez: sirve para buscar el icono en la cache de resultados y, si
+    // no estaba, para calcularlo
+    int factor = atoi(argv[3]);
+    DiskCache cache(DiskCache::DirFromEnvironment());
+    bool computed = false;
+    Image icon;
+    auto reduce = [&](const Image & image) {
+        computed = true;
+
+        // Mostrar los parametros de la Imagen
+        cout << endl;
+        cout << "Dimensiones de " << origen << ":" << endl;
+        cout << "   Imagen   = " << image.get_rows()  << " filas x " << image.get_cols() << " columnas " << endl;
+
+        // Reduce la imagen
+        return image.Subsample(factor);
+    };
+    if (!cache.Derive(origen, "Subsample(" + to_string(factor) + ")", reduce, icon)){
         cerr << "Error: No pudo leerse la imagen." << endl;
         cerr << "Terminando la ejecucion del programa." << endl;
         return 1;
     }
-
-    // Mostrar los parametros de la Imagen
-    cout << endl;
-    cout << "Dimensiones de " << origen << ":" << endl;
-    cout << "   Imagen   = " << image.get_rows()  << " filas x " << image.get_cols() << " columnas " << endl;
-
-    // Recorta la imagen
-    int factor = atoi(argv[3]);
-    Image icon = image.Subsample(factor);
+    if (!computed)
+        cout << "Resultado tomado de la cache" << endl;
 
     // Guardar la imagen resultado en el fichero
     if (icon.Save(destino))
@@ -5,11 +5,13 @@
  */
 
 #include <cstring>
+#include <cctype>
 #include <cassert>
 #include <iostream>
 
 #include <image.h>
 #include <imageIO.h>
+#include <instrument.h>
 #include <cmath>
 
 using namespace std;
@@ -21,12 +23,16 @@ void Image::Allocate(int nrows, int ncols, byte * buffer){
     rows = nrows;
     cols = ncols;
 
-    img = new byte * [rows];
+    table = new RowTable(rows);
+    img = table->rows;
+    IMAGE_PROFILE_ALLOC(rows * sizeof(byte *));
 
-    if (buffer != 0)
-        img[0] = buffer;
-    else
-        img[0] = new byte [rows * cols];
+    if (buffer == 0) {
+        buffer = new byte [rows * cols];
+        IMAGE_PROFILE_ALLOC(rows * cols);
+    }
+    this->buffer = new PixelBuffer(buffer, 0, (size_t)rows * cols);
+    img[0] = buffer;
 
     for (int i=1; i < rows; i++)
         img[i] = img[i-1] + cols;
@@ -37,6 +43,8 @@ void Image::Initialize (int nrows, int ncols, byte * buffer){
     if ((nrows == 0) || (ncols == 0)){
         rows = cols = 0;
         img = 0;
+        table = 0;
+        this->buffer = 0;
     }
     else Allocate(nrows, ncols, buffer);
 }
@@ -44,9 +52,25 @@ void Image::Initialize (int nrows, int ncols, byte * buffer){
 // Función auxiliar para copiar objetos Imagen
 
 void Image::Copy(const Image & orig){
-    Initialize(orig.rows,orig.cols);
-    for (int k=0; k<rows*cols;k++)
-        set_pixel(k,orig.get_pixel(k));
+    // Solo cuenta las llamadas: los píxeles se cuentan en "Unshare" si llegan a copiarse
+    IMAGE_PROFILE_SCOPE("Copy");
+    rows = orig.rows;
+    cols = orig.cols;
+    img = orig.img;
+    table = orig.table;
+    buffer = orig.buffer;
+    if (!Empty()){
+        table->refs.fetch_add(1, memory_order_relaxed);
+        buffer->refs.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+// Función auxiliar para saber si las filas están en orden y sin huecos en memoria
+bool Image::IsContiguous() const{
+    for (int i=1; i<rows; i++)
+        if (img[i] != img[i-1] + cols)
+            return false;
+    return true;
 }
 
 // Función auxiliar para destruir objetos Imagen
@@ -56,9 +80,39 @@ bool Image::Empty() const{
 
 void Image::Destroy(){
     if (!Empty()){
-        delete [] img[0];
-        delete [] img;
+        Release(table);
+        Release(buffer);
+    }
+}
+
+// Función auxiliar para dejar de compartir la tabla de filas antes de modificarla
+void Image::DetachTable(){
+    if (!table || table->refs.load(memory_order_acquire) == 1)
+        return;
+    RowTable * own = new RowTable(rows);
+    IMAGE_PROFILE_ALLOC(rows * sizeof(byte *));
+    memcpy(own->rows, img, rows * sizeof(byte *));
+    Release(table);
+    table = own;
+    img = own->rows;
+}
+
+// Función auxiliar para dejar de compartir los píxeles antes de escribir en ellos
+void Image::Unshare(){
+    IMAGE_PROFILE_SCOPE("Unshare");
+    IMAGE_PROFILE_PIXELS(rows * cols);
+    byte * data = new byte [rows * cols];
+    IMAGE_PROFILE_ALLOC(rows * cols);
+
+    // Las copias que comparten la tabla siguen viendo el bloque anterior
+    DetachTable();
+    for (int i=0; i<rows; i++){
+        memcpy(data + (size_t)i*cols, img[i], cols);
+        img[i] = data + (size_t)i*cols;
     }
+
+    Release(buffer);
+    buffer = new PixelBuffer(data, 0, (size_t)rows * cols);
 }
 
 LoadResult Image::LoadFromPGM(const char * file_path){
@@ -73,6 +127,26 @@ LoadResult Image::LoadFromPGM(const char * file_path){
     return LoadResult::SUCCESS;
 }
 
+LoadResult Image::LoadFromPGZ(const char * file_path){
+    byte * buffer = ReadPGZImage(file_path, rows, cols);
+    if (!buffer)
+        return LoadResult::READING_ERROR;
+
+    Initialize(rows, cols, buffer);
+    return LoadResult::SUCCESS;
+}
+
+// Función auxiliar para elegir el formato de salida por la extensión del fichero
+static bool HasExtension(const char * file_path, const char * ext){
+    size_t n = strlen(file_path), m = strlen(ext);
+    if (n < m)
+        return false;
+    for (size_t k = 0; k < m; ++k)
+        if (tolower((unsigned char)file_path[n - m + k]) != ext[k])
+            return false;
+    return true;
+}
+
 /********************************
        FUNCIONES PÚBLICAS
 ********************************/
@@ -86,12 +160,40 @@ Image::Image(){
 // Constructores con parámetros
 Image::Image (int nrows, int ncols, byte value){
     Initialize(nrows, ncols);
-    for (int k=0; k<rows*cols; k++) set_pixel(k,value);
+    if (!Empty())
+        memset(img[0], value, (size_t)rows*cols);
+}
+
+Image Image::Wrap (int nrows, int ncols, byte * data, void (*release)(byte *, size_t)){
+    Image wrapped;
+    wrapped.Allocate(nrows, ncols, data);
+    wrapped.buffer->release = release;
+    return wrapped;
 }
 
 bool Image::Load (const char * file_path) {
+    IMAGE_PROFILE_SCOPE("Load");
     Destroy();
-    return LoadFromPGM(file_path) == LoadResult::SUCCESS;
+    Initialize(); // Si la lectura falla la imagen queda vacía y no con punteros liberados
+    bool res = ReadImageKind(file_path) == IMG_PGZ ? LoadFromPGZ(file_path) == LoadResult::SUCCESS
+                                                   : LoadFromPGM(file_path) == LoadResult::SUCCESS;
+    IMAGE_PROFILE_PIXELS(size());
+    return res;
+}
+
+bool Image::LoadFromMemory (const unsigned char * data, size_t len) {
+    IMAGE_PROFILE_SCOPE("LoadFromMemory");
+    Destroy();
+    Initialize();
+
+    int nrows, ncols;
+    byte * buffer = DecodeImageBuffer(data, len, nrows, ncols);
+    if (!buffer)
+        return false;
+
+    Initialize(nrows, ncols, buffer);
+    IMAGE_PROFILE_PIXELS(size());
+    return true;
 }
 
 // Constructor de copias
@@ -101,6 +203,17 @@ Image::Image (const Image & orig){
     Copy(orig);
 }
 
+// Constructor de movimiento
+
+Image::Image (Image && orig){
+    img = orig.img;
+    table = orig.table;
+    buffer = orig.buffer;
+    rows = orig.rows;
+    cols = orig.cols;
+    orig.Initialize();
+}
+
 // Destructor
 
 Image::~Image(){
@@ -117,55 +230,37 @@ Image & Image::operator= (const Image & orig){
     return *this;
 }
 
-// Métodos de acceso a los campos de la clase
-
-int Image::get_rows() const {
-    return rows;
-}
-
-int Image::get_cols() const {
-    return cols;
-}
+// Operador de Asignación por movimiento
 
-int Image::size() const{
-    return get_rows()*get_cols();
-}
-
-// Métodos básicos de edición de imágenes
-void Image::set_pixel (int i, int j, byte value) {
-    img[i][j] = value;
-}
-byte Image::get_pixel (int i, int j) const {
-    return img[i][j];
-}
-
-// This doesn't work if representation changes
-void Image::set_pixel (int k, byte value) {
-    // TODO this makes assumptions about the internal representation
-    // TODO Can you reuse set_pixel(i,j,value)?
-    //img[0][k] = value;
-    this->set_pixel(0, k, value);
-}
-
-// This doesn't work if representation changes
-byte Image::get_pixel (int k) const {
-    // TODO this makes assumptions about the internal representation
-    // TODO Can you reuse get_pixel(i,j)?
-//    return img[0][k];
-    return this->get_pixel(0, k);
+Image & Image::operator= (Image && orig){
+    if (this != &orig){
+        Destroy();
+        img = orig.img;
+        table = orig.table;
+        buffer = orig.buffer;
+        rows = orig.rows;
+        cols = orig.cols;
+        orig.Initialize();
+    }
+    return *this;
 }
 
 // Métodos para almacenar y cargar imagenes en disco
 bool Image::Save (const char * file_path) const {
-    // TODO this makes assumptions about the internal representation
-    // byte * p = img[0];
-
-    // This does not make assumptions about the internal representation
-    byte *p = new byte[rows*cols];
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            p[j + cols*i] = img[i][j];
-        }
+    IMAGE_PROFILE_SCOPE("Save");
+    IMAGE_PROFILE_PIXELS(size());
+
+    // Si las filas no están en orden en memoria (p.ej. tras ShuffleRows) las juntamos en un buffer
+    const byte *p = Empty() ? 0 : img[0];
+    byte *staging = 0;
+    if (!IsContiguous()) {
+        staging = new byte[rows*cols];
+        IMAGE_PROFILE_ALLOC(rows*cols);
+        GatherInto(staging, img, rows, cols);
+        p = staging;
     }
-    return WritePGMImage(file_path, p, rows, cols);
+    bool res = HasExtension(file_path, ".pgz") ? WritePGZImage(file_path, p, rows, cols)
+                                               : WritePGMImage(file_path, p, rows, cols);
+    delete [] staging;
+    return res;
 }
@@ -0,0 +1,150 @@
+/**
+ * @file imageCache.cpp
+ * @brief Fichero con definiciones para la caché en memoria de imágenes
+ */
+
+#include <functional>
+
+#include <sys/stat.h>
+
+#include <imageCache.h>
+
+using namespace std;
+
+namespace {
+
+// Memoria que ocupa una imagen: sus píxeles y su tabla de filas
+size_t ImageBytes (const Image & image){
+    return (size_t)image.size() + image.get_rows() * sizeof(byte *);
+}
+
+}
+
+ImageCache::ImageCache (size_t budget, int nshards)
+    : shards(nshards > 0 ? nshards : 1) {
+    shard_budget = budget / shards.size();
+    for (Shard & s : shards){
+        s.bytes = 0;
+        s.hits = s.misses = s.insertions = s.evictions = 0;
+    }
+}
+
+ImageCache::Shard & ImageCache::ShardFor (const string & key){
+    return shards[hash<string>()(key) % shards.size()];
+}
+
+bool ImageCache::MakeKey (const char * path, const string & op, string & key){
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+
+    // Los separadores '\0' no pueden aparecer en la ruta, así que la clave no es ambigua
+    key = path;
+    key += '\0';
+    key += to_string((long long)st.st_mtim.tv_sec) + "." + to_string((long long)st.st_mtim.tv_nsec);
+    key += '\0';
+    key += to_string((long long)st.st_size);
+    key += '\0';
+    key += op;
+    return true;
+}
+
+// _____________________________________________________________________________
+
+bool ImageCache::Get (const string & key, Image & image){
+    return Lookup(key, image, true);
+}
+
+bool ImageCache::Lookup (const string & key, Image & image, bool count){
+    Shard & s = ShardFor(key);
+    lock_guard<mutex> lk(s.m);
+    auto it = s.index.find(key);
+    if (it == s.index.end()){
+        if (count)
+            s.misses++;
+        return false;
+    }
+
+    // La entrada pasa a ser la más reciente
+    s.lru.splice(s.lru.begin(), s.lru, it->second);
+    if (count)
+        s.hits++;
+    image = it->second->image;
+    return true;
+}
+
+void ImageCache::Put (const string & key, const Image & orig){
+    // Una vista se guarda copiada: si no, mantendría vivo el bloque entero de su imagen original
+    Image image = orig.BufferBytes() > (size_t)orig.size() ? orig.Crop(0, 0, orig.get_rows(), orig.get_cols()) : orig;
+    size_t bytes = ImageBytes(image);
+    if (bytes > shard_budget)
+        return;
+
+    Shard & s = ShardFor(key);
+    // La entrada expulsada se destruye fuera del cerrojo: liberar sus píxeles puede ser lento
+    list<Entry> evicted;
+    {
+        lock_guard<mutex> lk(s.m);
+        auto it = s.index.find(key);
+        if (it != s.index.end()){
+            s.bytes -= it->second->bytes;
+            evicted.splice(evicted.end(), s.lru, it->second);
+            s.index.erase(it);
+        }
+
+        while (!s.lru.empty() && s.bytes + bytes > shard_budget){
+            s.bytes -= s.lru.back().bytes;
+            s.index.erase(s.lru.back().key);
+            evicted.splice(evicted.end(), s.lru, prev(s.lru.end()));
+            s.evictions++;
+        }
+
+        Entry e = { key, image, bytes };
+        s.lru.push_front(e);
+        s.index[key] = s.lru.begin();
+        s.bytes += bytes;
+        s.insertions++;
+    }
+}
+
+bool ImageCache::Load (const char * path, Image & image){
+    return Load(path, image, true);
+}
+
+bool ImageCache::Load (const char * path, Image & image, bool count){
+    string key;
+    if (!MakeKey(path, "", key))
+        return false;
+    if (Lookup(key, image, count))
+        return true;
+    if (!image.Load(path))
+        return false;
+    Put(key, image);
+    return true;
+}
+
+// _____________________________________________________________________________
+
+ImageCacheStats ImageCache::Stats () const {
+    ImageCacheStats res = { 0, 0, 0, 0, 0, 0 };
+    for (const Shard & s : shards){
+        lock_guard<mutex> lk(s.m);
+        res.hits += s.hits;
+        res.misses += s.misses;
+        res.insertions += s.insertions;
+        res.evictions += s.evictions;
+        res.bytes += s.bytes;
+        res.entries += s.lru.size();
+    }
+    return res;
+}
+
+void ImageCache::Clear (){
+    for (Shard & s : shards){
+        list<Entry> evicted;
+        lock_guard<mutex> lk(s.m);
+        evicted.swap(s.lru);
+        s.index.clear();
+        s.bytes = 0;
+    }
+}
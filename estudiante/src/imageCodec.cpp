@@ -0,0 +1,386 @@
+/**
+  * @file imageCodec.cpp
+  * @brief Fichero con definiciones para el códec y la E/S del formato comprimido PGZ
+  *
+  */
+
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <cstdint>
+#include <atomic>
+
+#include <imageCodec.h>
+#include <imageIO.h>
+#include <fileIO.h>
+#include <parallel.h>
+#include <instrument.h>
+
+using namespace std;
+
+namespace {
+
+const int MIN_MATCH = 4;
+const int HASH_BITS = 14;
+const size_t MAX_OFFSET = 65535;
+
+// Filas por tira: unos 256 KB por tira para repartir bien entre hilos
+const int STRIP_BYTES = 1 << 18;
+
+const int HEADER_SIZE = 20;
+
+enum Filter : unsigned char { F_NONE, F_SUB, F_UP, F_AVG, F_PAETH, F_COUNT };
+
+// Primer byte de cada tira: las tiras que no se comprimen se guardan tal cual
+enum StripMode : unsigned char { STRIP_STORED, STRIP_LZ };
+
+inline uint32_t Read32 (const unsigned char *p){
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint32_t ReadLE32 (const unsigned char *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline void WriteLE32 (vector<unsigned char> &out, uint32_t v){
+    out.push_back(v & 0xFF);
+    out.push_back((v >> 8) & 0xFF);
+    out.push_back((v >> 16) & 0xFF);
+    out.push_back((v >> 24) & 0xFF);
+}
+
+// Longitudes >= 15 se codifican con bytes extra de 255 más un resto
+inline void WriteLength (vector<unsigned char> &out, size_t len){
+    while (len >= 255){
+        out.push_back(255);
+        len -= 255;
+    }
+    out.push_back((unsigned char)len);
+}
+
+inline bool ReadLength (const unsigned char *&ip, const unsigned char *end, size_t &len){
+    unsigned char b;
+    do {
+        if (ip >= end)
+            return false;
+        b = *ip++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+void EmitSequence (vector<unsigned char> &out, const unsigned char *lit, size_t nlit,
+                   size_t offset, size_t match){
+    size_t mlen = match ? match - MIN_MATCH : 0;
+    unsigned char token = (unsigned char)((nlit < 15 ? nlit : 15) << 4);
+    if (match)
+        token |= (unsigned char)(mlen < 15 ? mlen : 15);
+    out.push_back(token);
+    if (nlit >= 15)
+        WriteLength(out, nlit - 15);
+    out.insert(out.end(), lit, lit + nlit);
+    if (match){
+        out.push_back(offset & 0xFF);
+        out.push_back((offset >> 8) & 0xFF);
+        if (mlen >= 15)
+            WriteLength(out, mlen - 15);
+    }
+}
+
+inline unsigned char Paeth (int a, int b, int c){
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return (unsigned char)a;
+    return (unsigned char)(pb <= pc ? b : c);
+}
+
+// Residuo del filtro f en la columna j; prev es 0 en la primera fila de la tira
+inline unsigned char Predict (int f, const unsigned char *row, const unsigned char *prev, int j){
+    int a = j > 0 ? row[j - 1] : 0;
+    int b = prev ? prev[j] : 0;
+    int c = (prev && j > 0) ? prev[j - 1] : 0;
+    switch (f){
+        case F_SUB:   return (unsigned char)a;
+        case F_UP:    return (unsigned char)b;
+        case F_AVG:   return (unsigned char)((a + b) >> 1);
+        case F_PAETH: return Paeth(a, b, c);
+        default:      return 0;
+    }
+}
+
+}
+
+// _____________________________________________________________________________
+
+void LZCompress (const unsigned char *src, size_t n, vector<unsigned char> &out){
+    vector<uint32_t> table(1 << HASH_BITS, 0); // posición + 1 de la última aparición
+    size_t anchor = 0, ip = 0;
+
+    while (ip + MIN_MATCH <= n){
+        uint32_t seq = Read32(src + ip);
+        uint32_t h = (seq * 2654435761u) >> (32 - HASH_BITS);
+        size_t cand = table[h];
+        table[h] = (uint32_t)(ip + 1);
+
+        if (cand && ip - (cand - 1) <= MAX_OFFSET && Read32(src + cand - 1) == seq){
+            size_t ref = cand - 1, len = MIN_MATCH;
+            while (ip + len < n && src[ref + len] == src[ip + len])
+                ++len;
+            EmitSequence(out, src + anchor, ip - anchor, ip - ref, len);
+            ip += len;
+            anchor = ip;
+        }
+        else // En zonas incompresibles avanzamos cada vez más rápido
+            ip += 1 + ((ip - anchor) >> 6);
+    }
+
+    // La última secuencia solo lleva literales
+    EmitSequence(out, src + anchor, n - anchor, 0, 0);
+}
+
+// _____________________________________________________________________________
+
+bool LZDecompress (const unsigned char *src, size_t n, unsigned char *dst, size_t dst_len){
+    const unsigned char *ip = src, *iend = src + n;
+    unsigned char *op = dst, *oend = dst + dst_len;
+
+    while (ip < iend){
+        unsigned char token = *ip++;
+
+        size_t nlit = token >> 4;
+        if (nlit == 15 && !ReadLength(ip, iend, nlit))
+            return false;
+        if (nlit > (size_t)(iend - ip) || nlit > (size_t)(oend - op))
+            return false;
+        memcpy(op, ip, nlit);
+        op += nlit;
+        ip += nlit;
+
+        if (ip == iend)
+            break; // Última secuencia, sin coincidencia
+
+        if (iend - ip < 2)
+            return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t mlen = token & 0x0F;
+        if (mlen == 15 && !ReadLength(ip, iend, mlen))
+            return false;
+        mlen += MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - dst) || mlen > (size_t)(oend - op))
+            return false;
+
+        const unsigned char *ref = op - offset;
+        if (offset >= mlen)
+            memcpy(op, ref, mlen);
+        else // Solapamiento: la copia debe ser byte a byte
+            for (size_t k = 0; k < mlen; ++k)
+                op[k] = ref[k];
+        op += mlen;
+    }
+    return op == oend;
+}
+
+// _____________________________________________________________________________
+
+void EncodeStrip (const unsigned char *pixels, int rows, int cols, vector<unsigned char> &out){
+    vector<unsigned char> filtered((size_t)rows * (cols + 1));
+    vector<unsigned char> residual[F_COUNT];
+    for (int f = 0; f < F_COUNT; ++f)
+        residual[f].resize(cols);
+
+    for (int i = 0; i < rows; ++i){
+        const unsigned char *row = pixels + (size_t)i * cols;
+        const unsigned char *prev = i > 0 ? row - cols : 0;
+
+        // Elegimos el filtro con menor suma de residuos en valor absoluto (heurística de PNG)
+        int best = F_NONE;
+        long best_cost = LONG_MAX;
+        for (int f = 0; f < F_COUNT; ++f){
+            long cost = 0;
+            for (int j = 0; j < cols; ++j){
+                unsigned char r = (unsigned char)(row[j] - Predict(f, row, prev, j));
+                residual[f][j] = r;
+                cost += abs((int)(signed char)r);
+            }
+            if (cost < best_cost){
+                best_cost = cost;
+                best = f;
+            }
+        }
+
+        unsigned char *dst = filtered.data() + (size_t)i * (cols + 1);
+        dst[0] = (unsigned char)best;
+        memcpy(dst + 1, residual[best].data(), cols);
+    }
+
+    size_t start = out.size(), raw = (size_t)rows * cols;
+    out.push_back(STRIP_LZ);
+    LZCompress(filtered.data(), filtered.size(), out);
+
+    // Nunca expandimos: si la compresión no compensa guardamos los píxeles sin más
+    if (out.size() - start > raw + 1){
+        out.resize(start);
+        out.push_back(STRIP_STORED);
+        out.insert(out.end(), pixels, pixels + raw);
+    }
+}
+
+// _____________________________________________________________________________
+
+bool DecodeStrip (const unsigned char *src, size_t n, unsigned char *pixels, int rows, int cols){
+    if (n < 1)
+        return false;
+    if (src[0] == STRIP_STORED){
+        if (n - 1 != (size_t)rows * cols)
+            return false;
+        memcpy(pixels, src + 1, n - 1);
+        return true;
+    }
+
+    vector<unsigned char> filtered((size_t)rows * (cols + 1));
+    if (src[0] != STRIP_LZ || !LZDecompress(src + 1, n - 1, filtered.data(), filtered.size()))
+        return false;
+
+    for (int i = 0; i < rows; ++i){
+        const unsigned char *in = filtered.data() + (size_t)i * (cols + 1);
+        unsigned char *row = pixels + (size_t)i * cols;
+        const unsigned char *prev = i > 0 ? row - cols : 0;
+        int f = in[0];
+        ++in;
+
+        switch (f){
+            case F_NONE:
+                memcpy(row, in, cols);
+                break;
+            case F_SUB:
+                row[0] = in[0];
+                for (int j = 1; j < cols; ++j)
+                    row[j] = (unsigned char)(in[j] + row[j - 1]);
+                break;
+            case F_UP:
+                if (prev)
+                    for (int j = 0; j < cols; ++j)
+                        row[j] = (unsigned char)(in[j] + prev[j]);
+                else
+                    memcpy(row, in, cols);
+                break;
+            case F_AVG:
+            case F_PAETH:
+                for (int j = 0; j < cols; ++j)
+                    row[j] = (unsigned char)(in[j] + Predict(f, row, prev, j));
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+// _____________________________________________________________________________
+
+unsigned char *DecodePGZImage (const unsigned char *data, size_t len, int& rows, int& cols){
+    rows = cols = 0;
+    if (len < HEADER_SIZE || data[0] != 'P' || data[1] != 'Z' || data[2] != 1)
+        return 0;
+
+    uint32_t nrows = ReadLE32(data + 4), ncols = ReadLE32(data + 8);
+    uint32_t strip_rows = ReadLE32(data + 12), nstrips = ReadLE32(data + 16);
+    // La división se hace en 64 bits: con strip_rows cerca de 2^32 la suma desbordaría y
+    // nstrips == 0 pasaría por válido, devolviendo la imagen sin decodificar
+    if (nrows == 0 || ncols == 0 || (uint64_t)nrows * ncols > INT_MAX || strip_rows == 0 || nstrips == 0
+        || nstrips != ((uint64_t)nrows + strip_rows - 1) / strip_rows
+        || len - HEADER_SIZE < (uint64_t)nstrips * 4)
+        return 0;
+
+    // Posición de cada tira dentro del fichero
+    vector<size_t> offsets(nstrips + 1);
+    offsets[0] = HEADER_SIZE + (size_t)nstrips * 4;
+    for (uint32_t s = 0; s < nstrips; ++s)
+        offsets[s + 1] = offsets[s] + ReadLE32(data + HEADER_SIZE + 4 * s);
+    if (offsets[nstrips] != len)
+        return 0;
+
+    unsigned char *res = new unsigned char[(size_t)nrows * ncols];
+    IMAGE_PROFILE_ALLOC((size_t)nrows * ncols);
+    atomic<bool> ok(true);
+    ParallelFor(nstrips, [&](int begin, int end){
+        for (int s = begin; s < end && ok; ++s){
+            int first = s * strip_rows;
+            int n = (int)(first + strip_rows <= nrows ? strip_rows : nrows - first);
+            if (!DecodeStrip(data + offsets[s], offsets[s + 1] - offsets[s],
+                             res + (size_t)first * ncols, n, ncols))
+                ok = false;
+        }
+    });
+
+    if (!ok){
+        delete[] res;
+        return 0;
+    }
+    rows = nrows;
+    cols = ncols;
+    return res;
+}
+
+// _____________________________________________________________________________
+
+unsigned char *ReadPGZImage (const char *path, int& rows, int& cols){
+    rows = cols = 0;
+    vector<unsigned char> data;
+    if (!ReadFileBytes(path, data))
+        return 0;
+    IMAGE_PROFILE_IO(data.size());
+    return DecodePGZImage(data.data(), data.size(), rows, cols);
+}
+
+// _____________________________________________________________________________
+
+bool WritePGZImage (const char *path, const unsigned char *datos, const int rows, const int cols){
+    if (rows <= 0 || cols <= 0)
+        return false;
+
+    int strip_rows = STRIP_BYTES / cols;
+    if (strip_rows < 1)
+        strip_rows = 1;
+    int nstrips = (rows + strip_rows - 1) / strip_rows;
+
+    vector<vector<unsigned char> > strips(nstrips);
+    ParallelFor(nstrips, [&](int begin, int end){
+        for (int s = begin; s < end; ++s){
+            int first = s * strip_rows;
+            int n = first + strip_rows <= rows ? strip_rows : rows - first;
+            EncodeStrip(datos + (size_t)first * cols, n, cols, strips[s]);
+        }
+    });
+
+    vector<unsigned char> header;
+    header.push_back('P');
+    header.push_back('Z');
+    header.push_back(1);
+    header.push_back(0);
+    WriteLE32(header, rows);
+    WriteLE32(header, cols);
+    WriteLE32(header, strip_rows);
+    WriteLE32(header, nstrips);
+    for (int s = 0; s < nstrips; ++s)
+        WriteLE32(header, (uint32_t)strips[s].size());
+
+    // Cabecera y tiras se escriben con writev, sin copiarlas a un único buffer
+    vector<struct iovec> iov(nstrips + 1);
+    iov[0].iov_base = header.data();
+    iov[0].iov_len = header.size();
+    size_t total = header.size();
+    for (int s = 0; s < nstrips; ++s){
+        iov[s + 1].iov_base = strips[s].data();
+        iov[s + 1].iov_len = strips[s].size();
+        total += strips[s].size();
+    }
+    IMAGE_PROFILE_IO(total);
+    return WriteFileBlocks(path, iov.data(), (int)iov.size());
+}
+
+/* Fin Fichero: imageCodec.cpp */
@@ -0,0 +1,153 @@
+/**
+ * @file imageCompare.cpp
+ * @brief Fichero con definiciones para la comparación de imágenes
+ */
+
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <imageCompare.h>
+#include <imageKernels.h>
+#include <instrument.h>
+#include <parallel.h>
+
+namespace {
+
+// Filas de salida de cada banda del SSIM, como mínimo
+const int SSIM_BAND = 64;
+
+// Constantes del SSIM para imágenes de 8 bits: (0.01 * 255)^2 y (0.03 * 255)^2
+const double C1 = 6.5025, C2 = 58.5225;
+
+// Filas de cada banda al repartir filas de n píxeles entre hilos
+int RowGrain (int n) {
+    return std::max(1, (1 << 16) / std::max(n, 1));
+}
+
+}
+
+// _____________________________________________________________________________
+
+bool ImagesEqual (const Image & a, const Image & b) {
+    IMAGE_PROFILE_SCOPE("ImagesEqual");
+    if (a.get_rows() != b.get_rows() || a.get_cols() != b.get_cols())
+        return false;
+
+    std::atomic<bool> equal(true);
+    ParallelFor(a.get_rows(), [&](int begin, int end) {
+        for (int i = begin; i < end && equal.load(std::memory_order_relaxed); ++i)
+            if (memcmp(a.get_row(i), b.get_row(i), a.get_cols()) != 0)
+                equal.store(false, std::memory_order_relaxed);
+    }, RowGrain(a.get_cols()));
+    return equal;
+}
+
+ImageDiff CompareImages (const Image & a, const Image & b) {
+    IMAGE_PROFILE_SCOPE("CompareImages");
+    IMAGE_PROFILE_PIXELS(a.size());
+    const KernelTable & k = Kernels();
+    ImageDiff res = { 0, 0, 0, 0 };
+    unsigned long long sse = 0;
+    std::mutex m;
+
+    ParallelFor(a.get_rows(), [&](int begin, int end) {
+        unsigned long long band_sse = 0;
+        long long band_differing = 0;
+        int band_max = 0;
+        for (int i = begin; i < end; ++i) {
+            unsigned differ;
+            unsigned char max_diff;
+            band_sse += k.diff(a.get_row(i), b.get_row(i), a.get_cols(), &differ, &max_diff);
+            band_differing += differ;
+            band_max = std::max(band_max, (int)max_diff);
+        }
+        std::lock_guard<std::mutex> lk(m);
+        sse += band_sse;
+        res.differing += band_differing;
+        res.max_diff = std::max(res.max_diff, band_max);
+    }, RowGrain(a.get_cols()));
+
+    res.mse = a.size() > 0 ? (double)sse / a.size() : 0;
+    res.psnr = res.mse > 0 ? 10 * std::log10(255.0 * 255.0 / res.mse) : std::numeric_limits<double>::infinity();
+    return res;
+}
+
+double ImageSSIM (const Image & a, const Image & b, int window) {
+    IMAGE_PROFILE_SCOPE("ImageSSIM");
+    IMAGE_PROFILE_PIXELS(a.size());
+    const int rows = a.get_rows(), cols = a.get_cols();
+    if (rows == 0 || cols == 0)
+        return 1;
+    window = std::min(window, std::min(rows, cols));
+
+    // Ventanas con esquina superior izquierda en (i, j), 0 <= i < out_rows, 0 <= j < out_cols
+    const int out_rows = rows - window + 1, out_cols = cols - window + 1;
+    const int band = std::max(SSIM_BAND, window);
+    const int nbands = (out_rows + band - 1) / band;
+    const size_t stride = cols + 1;
+    const double n = (double)window * window;
+    std::vector<double> band_sum(nbands);
+
+    ParallelFor(nbands, [&](int bbegin, int bend) {
+        // Integrales de a, b, a^2, b^2 y a*b de las filas que cubren las ventanas de la banda
+        std::vector<unsigned long long> sa, sb, saa, sbb, sab;
+
+        for (int bnd = bbegin; bnd < bend; ++bnd) {
+            const int i0 = bnd * band, i1 = std::min(out_rows, i0 + band);
+            const int h = i1 - i0 + window - 1;
+            const size_t total = (size_t)(h + 1) * stride;
+            sa.assign(total, 0);
+            sb.assign(total, 0);
+            saa.assign(total, 0);
+            sbb.assign(total, 0);
+            sab.assign(total, 0);
+            for (int y = 1; y <= h; ++y) {
+                const byte * pa = a.get_row(i0 + y - 1);
+                const byte * pb = b.get_row(i0 + y - 1);
+                unsigned long long ra = 0, rb = 0, raa = 0, rbb = 0, rab = 0;
+                const size_t o = y * stride;
+                for (int x = 0; x < cols; ++x) {
+                    ra += pa[x];
+                    rb += pb[x];
+                    raa += (unsigned)pa[x] * pa[x];
+                    rbb += (unsigned)pb[x] * pb[x];
+                    rab += (unsigned)pa[x] * pb[x];
+                    sa[o + x + 1] = sa[o - stride + x + 1] + ra;
+                    sb[o + x + 1] = sb[o - stride + x + 1] + rb;
+                    saa[o + x + 1] = saa[o - stride + x + 1] + raa;
+                    sbb[o + x + 1] = sbb[o - stride + x + 1] + rbb;
+                    sab[o + x + 1] = sab[o - stride + x + 1] + rab;
+                }
+            }
+
+            double sum = 0;
+            for (int i = i0; i < i1; ++i) {
+                const size_t t = (size_t)(i - i0) * stride, d = t + (size_t)window * stride;
+                for (int j = 0; j < out_cols; ++j) {
+                    const size_t l = j, r = j + window;
+                    auto box = [&](const std::vector<unsigned long long> & s) {
+                        return (double)(s[d + r] - s[d + l] - s[t + r] + s[t + l]);
+                    };
+                    const double mu_a = box(sa) / n, mu_b = box(sb) / n;
+                    const double var_a = box(saa) / n - mu_a * mu_a;
+                    const double var_b = box(sbb) / n - mu_b * mu_b;
+                    const double cov = box(sab) / n - mu_a * mu_b;
+                    sum += ((2 * mu_a * mu_b + C1) * (2 * cov + C2))
+                         / ((mu_a * mu_a + mu_b * mu_b + C1) * (var_a + var_b + C2));
+                }
+            }
+            band_sum[bnd] = sum;
+        }
+    }, 1);
+
+    // Suma en orden de bandas: el resultado no depende del número de hilos
+    double sum = 0;
+    for (double s : band_sum)
+        sum += s;
+    return sum / ((double)out_rows * out_cols);
+}
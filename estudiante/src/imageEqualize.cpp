@@ -0,0 +1,166 @@
+/**
+ * @file imageEqualize.cpp
+ * @brief Fichero con definiciones para la ecualización del histograma de la clase Image
+ *
+ * CLAHE calcula en paralelo la tabla de cada bloque de la rejilla a partir de su histograma
+ * recortado. En la pasada final cada fila interpola primero en vertical, una sola vez por fila,
+ * las tablas de las dos filas de bloques que la rodean; después cada píxel toma los valores de
+ * los dos bloques de su izquierda y derecha y un núcleo vectorial los interpola en horizontal.
+ * Las interpolaciones usan punto fijo con 8 bits de fracción.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <image.h>
+#include <imageKernels.h>
+#include <instrument.h>
+#include <parallel.h>
+
+namespace {
+
+/*
+ * Bloques entre cuyos centros cae la posición pos, y peso del segundo con 8 bits de fracción.
+ * Antes del primer centro o después del último se usa solo el bloque del extremo.
+ */
+void Neighbours (int pos, const std::vector<double> & centers, int & lo, int & hi, uint16_t & w) {
+    const int n = (int)centers.size();
+    if (pos <= centers[0] || n == 1) {
+        lo = hi = 0;
+        w = 0;
+        return;
+    }
+    if (pos >= centers[n - 1]) {
+        lo = hi = n - 1;
+        w = 0;
+        return;
+    }
+    lo = (int)(std::upper_bound(centers.begin(), centers.end(), (double)pos) - centers.begin()) - 1;
+    hi = lo + 1;
+    w = (uint16_t)((pos - centers[lo]) / (centers[hi] - centers[lo]) * 256 + 0.5);
+}
+
+// Límites de los n bloques de un lado de longitud len, y sus centros
+void Grid (int len, int n, std::vector<int> & bounds, std::vector<double> & centers) {
+    bounds.resize(n + 1);
+    centers.resize(n);
+    for (int t = 0; t <= n; ++t)
+        bounds[t] = (int)((long long)len * t / n);
+    for (int t = 0; t < n; ++t)
+        centers[t] = (bounds[t] + bounds[t + 1] - 1) / 2.0;
+}
+
+}
+
+// _____________________________________________________________________________
+
+void Image::Equalize() {
+    IMAGE_PROFILE_SCOPE("Equalize");
+    IMAGE_PROFILE_PIXELS(size());
+    if (Empty())
+        return;
+
+    unsigned long long hist[256];
+    Histogram(hist);
+
+    // El nivel más bajo presente va a 0 y el más alto a 255
+    const unsigned long long total = (unsigned long long)rows * cols;
+    unsigned long long cdf_min = 0;
+    for (int v = 0; v < 256 && cdf_min == 0; ++v)
+        cdf_min = hist[v];
+    if (cdf_min == total)
+        return;
+
+    byte lut[256];
+    unsigned long long cdf = 0;
+    const unsigned long long den = total - cdf_min;
+    for (int v = 0; v < 256; ++v) {
+        cdf += hist[v];
+        lut[v] = cdf < cdf_min ? 0 : (byte)(((cdf - cdf_min) * 510 + den) / (2 * den));
+    }
+
+    Detach();
+    const KernelTable & k = Kernels();
+    ParallelFor(rows, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            k.lut(img[i], img[i], cols, lut);
+    }, std::max(1, (1 << 16) / std::max(cols, 1)));
+}
+
+void Image::CLAHE(int grid_rows, int grid_cols, double clip_limit) {
+    IMAGE_PROFILE_SCOPE("CLAHE");
+    IMAGE_PROFILE_PIXELS(size());
+    if (Empty())
+        return;
+
+    const int gr = std::min(grid_rows, rows), gc = std::min(grid_cols, cols);
+    std::vector<int> rb, cb;
+    std::vector<double> cy, cx;
+    Grid(rows, gr, rb, cy);
+    Grid(cols, gc, cb, cx);
+
+    // Tabla de cada bloque: histograma recortado, con el exceso repartido entre todos los niveles
+    std::vector<byte> luts((size_t)gr * gc * 256);
+    ParallelFor(gr * gc, [&](int begin, int end) {
+        for (int t = begin; t < end; ++t) {
+            const int r0 = rb[t / gc], r1 = rb[t / gc + 1], c0 = cb[t % gc], c1 = cb[t % gc + 1];
+            const long long area = (long long)(r1 - r0) * (c1 - c0);
+            long long hist[256] = { 0 };
+            for (int i = r0; i < r1; ++i) {
+                const byte * in = img[i];
+                for (int j = c0; j < c1; ++j)
+                    hist[in[j]]++;
+            }
+
+            const long long limit = std::max(1LL, (long long)(clip_limit * area / 256));
+            long long excess = 0;
+            for (int v = 0; v < 256; ++v)
+                if (hist[v] > limit) {
+                    excess += hist[v] - limit;
+                    hist[v] = limit;
+                }
+            long long rem = excess % 256;
+            for (int v = 0; v < 256; ++v)
+                hist[v] += excess / 256;
+            for (int v = 0, step = rem ? std::max(1, (int)(256 / rem)) : 1; v < 256 && rem > 0; v += step, --rem)
+                hist[v]++;
+
+            byte * lut = &luts[(size_t)t * 256];
+            long long cdf = 0;
+            for (int v = 0; v < 256; ++v) {
+                cdf += hist[v];
+                lut[v] = (byte)std::min(255LL, (cdf * 255 + area / 2) / area);
+            }
+        }
+    }, 1);
+
+    // Bloques y peso horizontales de cada columna
+    std::vector<int> left(cols), right(cols);
+    std::vector<uint16_t> wx(cols);
+    for (int j = 0; j < cols; ++j)
+        Neighbours(j, cx, left[j], right[j], wx[j]);
+
+    Detach();
+    const KernelTable & k = Kernels();
+    ParallelFor(rows, [&](int begin, int end) {
+        std::vector<uint16_t> vert((size_t)gc * 256), a(cols), b(cols);
+        for (int i = begin; i < end; ++i) {
+            int top, bottom;
+            uint16_t wy;
+            Neighbours(i, cy, top, bottom, wy);
+
+            // Tablas de esta fila: interpolación vertical de las de los bloques de arriba y abajo
+            const byte * lt = &luts[(size_t)top * gc * 256];
+            const byte * lb = &luts[(size_t)bottom * gc * 256];
+            for (int n = 0; n < gc * 256; ++n)
+                vert[n] = (uint16_t)(lt[n] * (256 - wy) + lb[n] * wy);
+
+            byte * row = img[i];
+            for (int j = 0; j < cols; ++j) {
+                a[j] = vert[left[j] * 256 + row[j]];
+                b[j] = vert[right[j] * 256 + row[j]];
+            }
+            k.blend_q8(a.data(), b.data(), wx.data(), row, cols);
+        }
+    }, std::max(1, (1 << 16) / std::max(cols, 1)));
+}
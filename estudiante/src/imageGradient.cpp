@@ -0,0 +1,151 @@
+/**
+ * @file imageGradient.cpp
+ * @brief Fichero con definiciones para los gradientes y la laplaciana de la clase Image
+ *
+ * Cada banda de filas guarda copias de las tres filas que rodean a la que se calcula, con un
+ * píxel más a cada lado que repite el del borde, de modo que los núcleos no necesitan casos
+ * especiales en los extremos. Al avanzar una fila se rotan las copias y solo se copia la nueva.
+ * Las componentes gx y gy solo existen para la fila en curso: el módulo, la orientación y la
+ * salida se calculan antes de pasar a la siguiente.
+ */
+
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include <image.h>
+#include <imageKernels.h>
+#include <instrument.h>
+#include <parallel.h>
+
+namespace {
+
+// Memoria de cada banda para la fila en curso
+struct RowScratch {
+    std::vector<int16_t> gx, gy;
+    std::vector<uint16_t> mag;
+};
+
+/*
+ * Recorre las filas de @a src llamando a fn(i, up, mid, down, scratch) con copias de las filas
+ * i - 1, i e i + 1 que pueden leerse en [-1, cols].
+ */
+template <class RowFn>
+void ForEachRow3 (const Image & src, RowFn fn) {
+    const int rows = src.get_rows(), cols = src.get_cols();
+    if (src.Empty())
+        return;
+
+    ParallelFor(rows, [&](int begin, int end) {
+        std::vector<byte> buf(3 * (size_t)(cols + 2));
+        byte * p[3] = { &buf[1], &buf[cols + 3], &buf[2 * (size_t)cols + 5] };
+        auto load = [&](byte * dst, int r) {
+            const byte * in = src.get_row(std::min(std::max(r, 0), rows - 1));
+            std::copy(in, in + cols, dst);
+            dst[-1] = in[0];
+            dst[cols] = in[cols - 1];
+        };
+
+        RowScratch scratch;
+        load(p[0], begin - 1);
+        load(p[1], begin);
+        load(p[2], begin + 1);
+        for (int i = begin; i < end; ++i) {
+            if (i > begin) {
+                std::rotate(p, p + 1, p + 3);
+                load(p[2], i + 1);
+            }
+            fn(i, p[0], p[1], p[2], scratch);
+        }
+    }, std::max(1, (1 << 16) / std::max(cols, 1)));
+}
+
+// Dirección del gradiente cuantizada a 4 valores, cortando en 22.5, 67.5, 112.5 y 157.5 grados
+void Orientation (const int16_t * gx, const int16_t * gy, byte * out, int n) {
+    for (int k = 0; k < n; ++k) {
+        const int ax = std::abs(gx[k]), ay = std::abs(gy[k]);
+        if (ay * 1000 <= ax * 414)
+            out[k] = 0;
+        else if (ax * 1000 <= ay * 414)
+            out[k] = 2;
+        else
+            out[k] = (gx[k] < 0) == (gy[k] < 0) ? 1 : 3;
+    }
+}
+
+/*
+ * Calcula el módulo del gradiente de cada fila y lo entrega con sink(i, modulo), rellenando
+ * también la orientación si se pide.
+ */
+template <class Sink>
+void GradientRows (const Image & src, GradientOperator op, GradientNorm norm, Image * orientation, Sink sink) {
+    const int cols = src.get_cols();
+    const int a = op == SCHARR ? 3 : 1, b = op == SCHARR ? 10 : 2;
+    if (orientation)
+        *orientation = Image(src.get_rows(), cols);
+
+    const KernelTable & k = Kernels();
+    ForEachRow3(src, [&](int i, const byte * up, const byte * mid, const byte * down, RowScratch & s) {
+        s.gx.resize(cols);
+        s.gy.resize(cols);
+        s.mag.resize(cols);
+        k.gradient(up, mid, down, a, b, s.gx.data(), s.gy.data(), cols);
+        k.magnitude(s.gx.data(), s.gy.data(), s.mag.data(), cols, norm == GRADIENT_L2);
+        if (orientation)
+            Orientation(s.gx.data(), s.gy.data(), orientation->get_row(i), cols);
+        sink(i, s.mag.data());
+    });
+}
+
+}
+
+// _____________________________________________________________________________
+
+Image Image::Gradient(GradientOperator op, GradientNorm norm, Image * orientation) const {
+    IMAGE_PROFILE_SCOPE("Gradient");
+    IMAGE_PROFILE_PIXELS(size());
+    Image res(rows, cols);
+    const KernelTable & k = Kernels();
+    GradientRows(*this, op, norm, orientation, [&](int i, const uint16_t * mag) {
+        k.saturate_u8(mag, res.get_row(i), cols);
+    });
+    return res;
+}
+
+void Image::Gradient16(std::vector<uint16_t> & magnitude, GradientOperator op, GradientNorm norm,
+                       Image * orientation) const {
+    IMAGE_PROFILE_SCOPE("Gradient16");
+    IMAGE_PROFILE_PIXELS(size());
+    magnitude.resize((size_t)rows * cols);
+    GradientRows(*this, op, norm, orientation, [&](int i, const uint16_t * mag) {
+        memcpy(&magnitude[(size_t)i * cols], mag, cols * sizeof(uint16_t));
+    });
+}
+
+// _____________________________________________________________________________
+
+Image Image::Laplacian() const {
+    IMAGE_PROFILE_SCOPE("Laplacian");
+    IMAGE_PROFILE_PIXELS(size());
+    Image res(rows, cols);
+    const KernelTable & k = Kernels();
+    ForEachRow3(*this, [&](int i, const byte * up, const byte * mid, const byte * down, RowScratch & s) {
+        s.gx.resize(cols);
+        s.mag.resize(cols);
+        k.laplacian(up, mid, down, s.gx.data(), cols);
+        for (int j = 0; j < cols; ++j)
+            s.mag[j] = (uint16_t)std::abs(s.gx[j]);
+        k.saturate_u8(s.mag.data(), res.get_row(i), cols);
+    });
+    return res;
+}
+
+void Image::Laplacian16(std::vector<int16_t> & laplacian) const {
+    IMAGE_PROFILE_SCOPE("Laplacian16");
+    IMAGE_PROFILE_PIXELS(size());
+    laplacian.resize((size_t)rows * cols);
+    const KernelTable & k = Kernels();
+    ForEachRow3(*this, [&](int i, const byte * up, const byte * mid, const byte * down, RowScratch &) {
+        k.laplacian(up, mid, down, &laplacian[(size_t)i * cols], cols);
+    });
+}
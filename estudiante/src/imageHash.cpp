@@ -0,0 +1,176 @@
+/**
+ * @file imageHash.cpp
+ * @brief Fichero con definiciones para los hashes perceptuales y el índice HashIndex
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include <imageHash.h>
+#include <instrument.h>
+
+namespace {
+
+// Lado de la reducción sobre la que se calcula la DCT del pHash, y lado del bloque que se usa
+const int PHASH_SIZE = 32;
+const int PHASH_LOW = 8;
+
+/*
+ * Reduce la imagen a out_rows x out_cols con medias de bloques. Antes se reduce con Subsample
+ * hasta quedar en como mucho unas 4 veces el tamaño final, que es donde está casi todo el coste.
+ */
+std::vector<double> Reduce (const Image & image, int out_rows, int out_cols) {
+    int factor = std::min(image.get_rows() / (4 * out_rows), image.get_cols() / (4 * out_cols));
+    const Image small = factor > 1 ? image.Subsample(factor, true) : image;
+    const int rows = small.get_rows(), cols = small.get_cols();
+
+    // Bloque de la celda k: filas [k * rows / out_rows, (k + 1) * rows / out_rows), al menos una
+    auto bounds = [](int k, int n, int out, int & b0, int & b1) {
+        b0 = std::min((int)((long long)k * n / out), n - 1);
+        b1 = std::max(b0 + 1, (int)((long long)(k + 1) * n / out));
+    };
+
+    std::vector<double> res((size_t)out_rows * out_cols);
+    for (int i = 0; i < out_rows; ++i) {
+        int r0, r1;
+        bounds(i, rows, out_rows, r0, r1);
+        for (int j = 0; j < out_cols; ++j) {
+            int c0, c1;
+            bounds(j, cols, out_cols, c0, c1);
+            long long sum = 0;
+            for (int r = r0; r < r1; ++r) {
+                const byte * in = small.get_row(r);
+                for (int c = c0; c < c1; ++c)
+                    sum += in[c];
+            }
+            res[(size_t)i * out_cols + j] = (double)sum / ((long long)(r1 - r0) * (c1 - c0));
+        }
+    }
+    return res;
+}
+
+uint64_t AverageHash (const Image & image) {
+    std::vector<double> p = Reduce(image, 8, 8);
+    double mean = 0;
+    for (double v : p)
+        mean += v;
+    mean /= 64;
+
+    uint64_t h = 0;
+    for (int k = 0; k < 64; ++k)
+        h |= (uint64_t)(p[k] > mean) << k;
+    return h;
+}
+
+uint64_t DifferenceHash (const Image & image) {
+    std::vector<double> p = Reduce(image, 8, 9);
+    uint64_t h = 0;
+    for (int i = 0; i < 8; ++i)
+        for (int j = 0; j < 8; ++j)
+            h |= (uint64_t)(p[i * 9 + j + 1] > p[i * 9 + j]) << (i * 8 + j);
+    return h;
+}
+
+uint64_t DctHash (const Image & image) {
+    std::vector<double> p = Reduce(image, PHASH_SIZE, PHASH_SIZE);
+
+    // Solo hacen falta los PHASH_LOW primeros coeficientes de la DCT-II en cada dirección
+    static const std::vector<double> basis = [] {
+        std::vector<double> c(PHASH_LOW * PHASH_SIZE);
+        for (int u = 0; u < PHASH_LOW; ++u)
+            for (int x = 0; x < PHASH_SIZE; ++x)
+                c[u * PHASH_SIZE + x] = std::cos((2 * x + 1) * u * M_PI / (2 * PHASH_SIZE));
+        return c;
+    }();
+
+    // Primero por filas (PHASH_SIZE x PHASH_LOW) y después por columnas (PHASH_LOW x PHASH_LOW)
+    std::vector<double> rows(PHASH_SIZE * PHASH_LOW), coef(PHASH_LOW * PHASH_LOW);
+    for (int y = 0; y < PHASH_SIZE; ++y)
+        for (int v = 0; v < PHASH_LOW; ++v) {
+            double s = 0;
+            for (int x = 0; x < PHASH_SIZE; ++x)
+                s += basis[v * PHASH_SIZE + x] * p[y * PHASH_SIZE + x];
+            rows[y * PHASH_LOW + v] = s;
+        }
+    for (int u = 0; u < PHASH_LOW; ++u)
+        for (int v = 0; v < PHASH_LOW; ++v) {
+            double s = 0;
+            for (int y = 0; y < PHASH_SIZE; ++y)
+                s += basis[u * PHASH_SIZE + y] * rows[y * PHASH_LOW + v];
+            coef[u * PHASH_LOW + v] = s;
+        }
+
+    // La mediana sin el término constante, que solo depende del brillo medio
+    std::vector<double> sorted(coef.begin() + 1, coef.end());
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    const double median = sorted[sorted.size() / 2];
+
+    uint64_t h = 0;
+    for (int k = 0; k < 64; ++k)
+        h |= (uint64_t)(coef[k] > median) << k;
+    return h;
+}
+
+}
+
+// _____________________________________________________________________________
+
+uint64_t PerceptualHash (const Image & image, HashKind kind) {
+    IMAGE_PROFILE_SCOPE("PerceptualHash");
+    IMAGE_PROFILE_PIXELS(image.size());
+    if (image.Empty())
+        return 0;
+    switch (kind) {
+        case AHASH: return AverageHash(image);
+        case PHASH: return DctHash(image);
+        default:    return DifferenceHash(image);
+    }
+}
+
+// _____________________________________________________________________________
+
+void HashIndex::Add (uint64_t hash, int id) {
+    Node node = { hash, id, 0, -1, -1 };
+    if (nodes.empty()) {
+        nodes.push_back(node);
+        return;
+    }
+
+    // Bajamos por el hijo a la misma distancia que el nuevo hash hasta que no lo haya
+    int cur = 0;
+    while (true) {
+        int d = HammingDistance(hash, nodes[cur].hash);
+        int child = nodes[cur].first_child;
+        while (child >= 0 && nodes[child].dist != d)
+            child = nodes[child].next_sibling;
+        if (child < 0) {
+            node.dist = d;
+            node.next_sibling = nodes[cur].first_child;
+            nodes[cur].first_child = (int)nodes.size();
+            nodes.push_back(node);
+            return;
+        }
+        cur = child;
+    }
+}
+
+void HashIndex::Query (uint64_t hash, int radius, std::vector<int> & ids) const {
+    ids.clear();
+    if (nodes.empty())
+        return;
+
+    std::vector<int> pending(1, 0);
+    while (!pending.empty()) {
+        int cur = pending.back();
+        pending.pop_back();
+        int d = HammingDistance(hash, nodes[cur].hash);
+        if (d <= radius)
+            ids.push_back(nodes[cur].id);
+
+        // Por la desigualdad triangular, solo los hijos a distancia en [d - radius, d + radius]
+        for (int child = nodes[cur].first_child; child >= 0; child = nodes[child].next_sibling)
+            if (std::abs(nodes[child].dist - d) <= radius)
+                pending.push_back(child);
+    }
+}
@@ -2,72 +2,183 @@
   * @file imageIO.cpp
   * @brief Fichero con definiciones para la E/S de imágenes
   *
-  * Permite la E/S de archivos de tipo PGM,PPM
+  * Permite la E/S de archivos de tipo PGM,PPM,PBM
   *
   */
 
-#include <string>
+#include <cstring>
+#include <cstdio>
+#include <climits>
+#include <cerrno>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
 
 #include <imageIO.h>
+#include <imageCodec.h>
+#include <fileIO.h>
+#include <instrument.h>
 
-#include <fstream>
 using namespace std;
 
+// Bytes que se leen de una vez al abrir una imagen; bastan para la cabecera y,
+// en imágenes pequeñas, también para todos los píxeles
+const size_t HEADER_CHUNK = 4096;
+
+inline bool IsSpace (unsigned char c){
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// _____________________________________________________________________________
 
-ImageKind ReadKind(ifstream& f){
-  char c1,c2;
+ImageKind ReadKind (const unsigned char *data, size_t len){
   ImageKind res= IMG_UNKNOWN;
 
-  if (f){
-    c1=f.get();
-    c2=f.get();
-    if (f && c1=='P')
-      switch (c2) {
-        case '5': res= IMG_PGM; break;
-        case '6': res= IMG_PPM; break;
-        default: res= IMG_UNKNOWN;
-      }
-  }
+  if (len >= 2 && data[0] == 'P')
+    switch (data[1]) {
+      case '4': res= IMG_PBM; break;
+      case '5': res= IMG_PGM; break;
+      case '6': res= IMG_PPM; break;
+      case 'Z': res= IMG_PGZ; break;
+      default: res= IMG_UNKNOWN;
+    }
   return res;
 }
 
 // _____________________________________________________________________________
 
+// Lee hasta n bytes desde la posición offset; devuelve los bytes leídos
+size_t ReadAt (int fd, unsigned char *buf, size_t n, size_t offset){
+  size_t done = 0;
+  while (done < n){
+    ssize_t r = pread(fd, buf + done, n - done, offset + done);
+    if (r > 0)
+      done += r;
+    else if (r == 0 || errno != EINTR)
+      break;
+  }
+  return done;
+}
+
+// _____________________________________________________________________________
+
 ImageKind ReadImageKind(const char *nombre){
-  ifstream f(nombre);
-  return ReadKind(f);
+  unsigned char magic[2];
+  int fd = open(nombre, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return IMG_UNKNOWN;
+  size_t n = ReadAt(fd, magic, 2, 0);
+  close(fd);
+  return ReadKind(magic, n);
 }
 
 
 // _____________________________________________________________________________
 
-char SkipWhitespaces (ifstream& f){
-  char c;
-  do{
-    c= f.get();
-  } while (isspace(c));
-  f.putback(c);
-  return c;
+// Salta blancos y comentarios. Devuelve false si se acaba el bloque.
+bool SkipWhitespaces (const unsigned char *data, size_t len, size_t &pos){
+  while (pos < len){
+    if (data[pos] == '#')
+      while (pos < len && data[pos] != '\n' && data[pos] != '\r')
+        ++pos;
+    else if (IsSpace(data[pos]))
+      ++pos;
+    else
+      return true;
+  }
+  return false;
 }
 
 // _____________________________________________________________________________
 
-bool ReadHeader (ifstream& f, int& rows, int& cols){
-    int maxvalor;
-    string linea;
-    while (SkipWhitespaces(f) == '#')
-      getline(f,linea);
-    f >> cols >> rows >> maxvalor;
-    
-    if (/*str &&*/ f && rows>0 && rows<5000 && cols>0 && cols<5000){
-        f.get(); // Saltamos separador
-        return true;
-    }
-    else 
+// Lee un entero decimal sin signo. El número debe terminar dentro del bloque
+// en un blanco o en el inicio de un comentario.
+bool ReadNumber (const unsigned char *data, size_t len, size_t &pos, int &value){
+  if (!SkipWhitespaces(data, len, pos) || data[pos] < '0' || data[pos] > '9')
+    return false;
+
+  long long v = 0;
+  while (pos < len && data[pos] >= '0' && data[pos] <= '9'){
+    v = v * 10 + (data[pos] - '0');
+    if (v > INT_MAX)
       return false;
+    ++pos;
+  }
+  if (pos >= len || !(IsSpace(data[pos]) || data[pos] == '#'))
+    return false;
+
+  value = (int)v;
+  return true;
+}
+
+// _____________________________________________________________________________
+
+bool ParsePNMHeader (const unsigned char *data, size_t len, PNMHeader &h){
+  h.kind = ReadKind(data, len);
+  if (h.kind != IMG_PGM && h.kind != IMG_PPM && h.kind != IMG_PBM)
+    return false;
+  size_t pos = 2;
+  if (pos >= len || !(IsSpace(data[pos]) || data[pos] == '#'))
+    return false;
+
+  if (!ReadNumber(data, len, pos, h.cols) || !ReadNumber(data, len, pos, h.rows))
+    return false;
+  h.maxval = 1;
+  if (h.kind != IMG_PBM && !ReadNumber(data, len, pos, h.maxval))
+    return false;
+
+  // Tras el último campo va exactamente un blanco y después los píxeles
+  if (!IsSpace(data[pos]))
+    return false;
+  h.offset = (unsigned)(pos + 1);
+
+  long long channels = h.kind == IMG_PPM ? 3 : 1;
+  return h.rows > 0 && h.rows <= PNM_MAX_DIMENSION && h.cols > 0 && h.cols <= PNM_MAX_DIMENSION
+         && (long long)h.rows * h.cols * channels <= INT_MAX
+         && h.maxval > 0 && h.maxval <= 255;
+}
+
+// _____________________________________________________________________________
+
+int FormatPGMHeader (char *buf, int rows, int cols){
+  return snprintf(buf, PGM_HEADER_MAX, "P5\n%d %d\n255\n", cols, rows);
+}
+
+// _____________________________________________________________________________
+
+unsigned char *DecodePGMImage (const unsigned char *data, size_t len, int& rows, int& cols){
+  PNMHeader h;
+  rows = 0;
+  cols = 0;
+
+  if (!ParsePNMHeader(data, len, h) || h.kind != IMG_PGM)
+    return 0;
+  size_t total = (size_t)h.rows * h.cols;
+  if (len - h.offset < total)
+    return 0;
+
+  unsigned char *res = new unsigned char[total];
+  IMAGE_PROFILE_ALLOC(total);
+  memcpy(res, data + h.offset, total);
+  rows = h.rows;
+  cols = h.cols;
+  return res;
 }
 
+// _____________________________________________________________________________
 
+unsigned char *DecodeImageBuffer (const unsigned char *data, size_t len, int& rows, int& cols){
+  switch (ReadKind(data, len)){
+    case IMG_PGM: return DecodePGMImage(data, len, rows, cols);
+    case IMG_PGZ: return DecodePGZImage(data, len, rows, cols);
+    default:
+      rows = 0;
+      cols = 0;
+      return 0;
+  }
+}
 
 // _____________________________________________________________________________
 
@@ -75,18 +186,46 @@ unsigned char *ReadPGMImage (const char *path, int& rows, int& cols){
   unsigned char *res=0;
   rows=0;
   cols=0;
-  ifstream f(path);
-  
-  if (ReadKind(f) == IMG_PGM){
-    if (ReadHeader(f, rows, cols)){
-      res= new unsigned char[rows*cols];
-      f.read(reinterpret_cast<char *>(res),rows*cols);
-      if (!f){
-        delete[] res;
-        res= 0;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return 0;
+
+  // Una sola lectura trae la cabecera y, si la imagen es pequeña, todos los píxeles
+  unsigned char head[HEADER_CHUNK];
+  size_t n = ReadAt(fd, head, sizeof(head), 0);
+  IMAGE_PROFILE_IO(n);
+  PNMHeader h;
+
+  if (ParsePNMHeader(head, n, h)){
+    if (h.kind == IMG_PGM){
+      size_t total = (size_t)h.rows * h.cols;
+      size_t have = n - h.offset < total ? n - h.offset : total;
+      res = new unsigned char[total];
+      IMAGE_PROFILE_ALLOC(total);
+      memcpy(res, head + h.offset, have);
+      if (have < total){
+        size_t got = ReadAt(fd, res + have, total - have, h.offset + have);
+        IMAGE_PROFILE_IO(got);
+        if (got != total - have){
+          delete[] res;
+          res = 0;
+        }
       }
+      if (res){
+        rows = h.rows;
+        cols = h.cols;
+      }
+    }
+  }
+  else if (n == sizeof(head)){
+    // Cabecera más larga que el bloque (comentarios extensos): leemos el fichero entero
+    vector<unsigned char> data;
+    if (ReadFileBytes(path, data)){
+      IMAGE_PROFILE_IO(data.size());
+      res = DecodePGMImage(data.data(), data.size(), rows, cols);
     }
   }
+  close(fd);
   return res;
 }
 
@@ -94,20 +233,69 @@ unsigned char *ReadPGMImage (const char *path, int& rows, int& cols){
 
 bool WritePGMImage (const char *nombre, const unsigned char *datos,
                     const int rows, const int cols){
-  ofstream f(nombre);
-  bool res= true;
-  
-  if (f){
-    f << "P5" << endl;
-    f << cols << ' ' << rows << endl;
-    f << 255 << endl;
-    f.write(reinterpret_cast<const char *>(datos),rows*cols);
-    if (!f)
-      res=false;
-  }
+  char header[PGM_HEADER_MAX];
+  int n = FormatPGMHeader(header, rows, cols);
+
+  // Cabecera y píxeles se escriben con una sola llamada al sistema
+  struct iovec iov[2];
+  iov[0].iov_base = header;
+  iov[0].iov_len = n;
+  iov[1].iov_base = const_cast<unsigned char *>(datos);
+  iov[1].iov_len = (size_t)rows * cols;
+  IMAGE_PROFILE_IO(n + iov[1].iov_len);
+  return WriteFileBlocks(nombre, iov, 2);
+}
+
+// _____________________________________________________________________________
+
+unsigned char *DecodePBMImage (const unsigned char *data, size_t len, int& rows, int& cols){
+  PNMHeader h;
+  rows = 0;
+  cols = 0;
+
+  if (!ParsePNMHeader(data, len, h) || h.kind != IMG_PBM)
+    return 0;
+  size_t total = (size_t)h.rows * PBMRowBytes(h.cols);
+  if (len - h.offset < total)
+    return 0;
+
+  unsigned char *res = new unsigned char[total];
+  IMAGE_PROFILE_ALLOC(total);
+  memcpy(res, data + h.offset, total);
+  rows = h.rows;
+  cols = h.cols;
   return res;
 }
 
+// _____________________________________________________________________________
+
+unsigned char *ReadPBMImage (const char *path, int& rows, int& cols){
+  rows = 0;
+  cols = 0;
+  // Los ficheros PBM son 8 veces más pequeños que los PGM: los leemos enteros de una vez
+  vector<unsigned char> data;
+  if (!ReadFileBytes(path, data))
+    return 0;
+  IMAGE_PROFILE_IO(data.size());
+  return DecodePBMImage(data.data(), data.size(), rows, cols);
+}
+
+// _____________________________________________________________________________
+
+bool WritePBMImage (const char *nombre, const unsigned char *datos,
+                    const int rows, const int cols){
+  char header[PGM_HEADER_MAX];
+  int n = snprintf(header, sizeof(header), "P4\n%d %d\n", cols, rows);
+
+  struct iovec iov[2];
+  iov[0].iov_base = header;
+  iov[0].iov_len = n;
+  iov[1].iov_base = const_cast<unsigned char *>(datos);
+  iov[1].iov_len = (size_t)rows * PBMRowBytes(cols);
+  IMAGE_PROFILE_IO(n + iov[1].iov_len);
+  return WriteFileBlocks(nombre, iov, 2);
+}
+
 
 /* Fin Fichero: imagenES.cpp */
 
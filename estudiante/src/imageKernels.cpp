@@ -0,0 +1,91 @@
+/**
+ * @file imageKernels.cpp
+ * @brief Fichero con definiciones para la selección en ejecución de los núcleos de cálculo
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <imageKernels.h>
+
+using namespace std;
+
+extern const KernelTable kernels_baseline;
+#ifdef IMAGE_DISPATCH_X86
+extern const KernelTable kernels_sse42;
+extern const KernelTable kernels_avx2;
+extern const KernelTable kernels_avx512;
+#endif
+
+namespace {
+
+bool CpuSupports (CpuTier tier){
+#ifdef IMAGE_DISPATCH_X86
+    __builtin_cpu_init();
+    switch (tier){
+        case TIER_BASELINE: return true;
+        case TIER_SSE42:    return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+        case TIER_AVX2:     return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+        case TIER_AVX512:   return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+                                   && __builtin_cpu_supports("popcnt");
+        default:            return false;
+    }
+#else
+    return tier == TIER_BASELINE;
+#endif
+}
+
+const KernelTable * CompiledTable (CpuTier tier){
+    switch (tier){
+        case TIER_BASELINE: return &kernels_baseline;
+#ifdef IMAGE_DISPATCH_X86
+        case TIER_SSE42:    return &kernels_sse42;
+        case TIER_AVX2:     return &kernels_avx2;
+        case TIER_AVX512:   return &kernels_avx512;
+#endif
+        default:            return 0;
+    }
+}
+
+CpuTier SelectTier (){
+    CpuTier best = TIER_BASELINE;
+    for (int t = TIER_BASELINE; t < TIER_COUNT; ++t)
+        if (KernelsForTier((CpuTier)t))
+            best = (CpuTier)t;
+
+    const char *forced = getenv("IMAGE_CPU_TIER");
+    if (forced && *forced){
+        for (int t = TIER_BASELINE; t < TIER_COUNT; ++t)
+            if (strcmp(forced, TierName((CpuTier)t)) == 0){
+                if (KernelsForTier((CpuTier)t))
+                    return (CpuTier)t;
+                break;
+            }
+        cerr << "Aviso: IMAGE_CPU_TIER=" << forced << " no disponible, se usa " << TierName(best) << endl;
+    }
+    return best;
+}
+
+}
+
+// _____________________________________________________________________________
+
+CpuTier ActiveTier (){
+    static const CpuTier tier = SelectTier();
+    return tier;
+}
+
+const KernelTable & Kernels (){
+    static const KernelTable *table = CompiledTable(ActiveTier());
+    return *table;
+}
+
+const KernelTable * KernelsForTier (CpuTier tier){
+    return CpuSupports(tier) ? CompiledTable(tier) : 0;
+}
+
+const char * TierName (CpuTier tier){
+    static const char *names[TIER_COUNT] = { "baseline", "sse4.2", "avx2", "avx512" };
+    return tier >= TIER_BASELINE && tier < TIER_COUNT ? names[tier] : "unknown";
+}
@@ -0,0 +1,337 @@
+/**
+ * @file imageLabel.cpp
+ * @brief Fichero con definiciones para el etiquetado de componentes conexas
+ *
+ * Etiquetado en dos pasadas sobre bandas de filas, una por hilo:
+ *
+ * 1. Cada banda recorre sus píxeles y da a cada uno la etiqueta provisional de un vecino ya
+ *    visitado, o una nueva si no tiene ninguno; cuando dos vecinos tienen etiquetas distintas las
+ *    une en un union-find. Las etiquetas de cada banda salen de un intervalo propio, así que
+ *    las bandas no se estorban.
+ * 2. Se unen las etiquetas de las dos filas de cada frontera entre bandas. Aquí sí pueden
+ *    coincidir varios hilos sobre el mismo conjunto: la unión enlaza la raíz mayor con la menor
+ *    mediante compare-and-swap y reintenta si otra unión se le adelantó.
+ * 3. Las raíces (la etiqueta menor de cada conjunto, que es la del primer píxel de la
+ *    componente) se numeran en orden, y cada banda sustituye sus etiquetas provisionales por las
+ *    definitivas mientras acumula las estadísticas.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+#include <imageLabel.h>
+#include <instrument.h>
+#include <parallel.h>
+
+namespace {
+
+typedef std::atomic<int> Parent;
+
+/*
+ * Raíz del conjunto de x. Acorta el camino a la mitad sobre la marcha: escribir en p[x] un
+ * antecesor suyo es seguro aunque otro hilo esté recorriendo o uniendo el mismo conjunto.
+ */
+int Find (Parent * p, int x) {
+    while (true) {
+        int y = p[x].load(std::memory_order_relaxed);
+        if (y == x)
+            return x;
+        int z = p[y].load(std::memory_order_relaxed);
+        if (z != y)
+            p[x].store(z, std::memory_order_relaxed);
+        x = z;
+    }
+}
+
+/*
+ * Raíz del conjunto de x sin escribir en p. Para cuando otros hilos sustituyen a la vez sus
+ * entradas por la raíz: un Find que acorta el camino podría pisar esa raíz con un antecesor
+ * leído antes.
+ */
+int Root (const Parent * p, int x) {
+    int y;
+    while ((y = p[x].load(std::memory_order_relaxed)) != x)
+        x = y;
+    return x;
+}
+
+// Une los conjuntos de a y b enlazando la raíz mayor con la menor
+void Union (Parent * p, int a, int b) {
+    while (true) {
+        a = Find(p, a);
+        b = Find(p, b);
+        if (a == b)
+            return;
+        if (a < b)
+            std::swap(a, b);
+        int expected = a;
+        if (p[a].compare_exchange_weak(expected, b))
+            return;
+    }
+}
+
+// Acumulador de las estadísticas de una componente
+struct Acc {
+    long long area, sum_r, sum_c;
+    int top, left, bottom, right;
+
+    Acc () : area(0), sum_r(0), sum_c(0), top(0), left(0), bottom(0), right(0) {}
+
+    // Añade los píxeles j0 .. j1 - 1 de la fila i
+    void AddRun (int i, int j0, int j1) {
+        long long n = j1 - j0;
+        if (area == 0) {
+            top = bottom = i;
+            left = j0;
+            right = j1 - 1;
+        }
+        else {
+            top = std::min(top, i);
+            bottom = std::max(bottom, i);
+            left = std::min(left, j0);
+            right = std::max(right, j1 - 1);
+        }
+        area += n;
+        sum_r += n * i;
+        sum_c += n * (j0 + j1 - 1) / 2;
+    }
+
+    void Merge (const Acc & o) {
+        if (o.area == 0)
+            return;
+        if (area == 0) {
+            *this = o;
+            return;
+        }
+        top = std::min(top, o.top);
+        bottom = std::max(bottom, o.bottom);
+        left = std::min(left, o.left);
+        right = std::max(right, o.right);
+        area += o.area;
+        sum_r += o.sum_r;
+        sum_c += o.sum_c;
+    }
+
+    ComponentStats Stats () const {
+        ComponentStats s = { area, top, left, bottom, right, (double)sum_r / area, (double)sum_c / area };
+        return s;
+    }
+};
+
+// Filas de una imagen de grises: primer plano los píxeles distintos de 0
+struct ImageRows {
+    const Image & image;
+    int get_rows () const { return image.get_rows(); }
+    int get_cols () const { return image.get_cols(); }
+    void Expand (int i, unsigned char * out) const {
+        const byte * in = image.get_row(i);
+        for (int j = 0; j < image.get_cols(); ++j)
+            out[j] = in[j] != 0;
+    }
+};
+
+// Filas de una máscara: primer plano los píxeles a 1
+struct MaskRows {
+    const BitImage & mask;
+    int get_rows () const { return mask.get_rows(); }
+    int get_cols () const { return mask.get_cols(); }
+    void Expand (int i, unsigned char * out) const {
+        const uint64_t * in = mask.get_row(i);
+        for (int j = 0; j < mask.get_cols(); ++j)
+            out[j] = (in[j / 64] >> (j % 64)) & 1;
+    }
+};
+
+}
+
+// _____________________________________________________________________________
+
+LabelMap::LabelMap () : rows(0), cols(0) {}
+
+BitImage LabelMap::Mask (int label) const {
+    BitImage res(rows, cols);
+    const ComponentStats & s = Stats(label);
+    for (int i = s.top; i <= s.bottom; ++i) {
+        const int * in = get_row(i);
+        for (int j = s.left; j <= s.right; ++j)
+            if (in[j] == label)
+                res.set_bit(i, j, true);
+    }
+    return res;
+}
+
+template <class Source>
+LabelMap LabelMap::Label (const Source & src, Connectivity conn) {
+    LabelMap res;
+    const int rows = src.get_rows(), cols = src.get_cols();
+    if (rows == 0 || cols == 0)
+        return res;
+    res.rows = rows;
+    res.cols = cols;
+    res.labels.reset(new int[(size_t)rows * cols]);
+    int * L = res.labels.get();
+
+    // Una banda por hilo. Cada fila abre como mucho (cols + 1) / 2 tramos y por tanto etiquetas
+    // nuevas: la banda que empieza en la fila r usa las etiquetas desde r * half + 1.
+    const int nbands = std::min(rows, GetNumThreads());
+    const long long half = (cols + 1) / 2;
+    std::vector<int> band_row(nbands + 1), used(nbands), roots(nbands), first(nbands + 1);
+    for (int b = 0; b <= nbands; ++b)
+        band_row[b] = (int)((long long)rows * b / nbands);
+    std::unique_ptr<Parent[]> parent(new Parent[rows * half + 1]);
+    Parent * p = parent.get();
+
+    // Primera pasada: etiquetas provisionales y uniones dentro de cada banda
+    ParallelFor(nbands, [&](int bbegin, int bend) {
+        std::vector<unsigned char> fg(cols);
+        for (int b = bbegin; b < bend; ++b) {
+            const int r0 = band_row[b];
+            const int base = (int)(r0 * half + 1);
+            int next = base;
+            for (int i = r0; i < band_row[b + 1]; ++i) {
+                src.Expand(i, fg.data());
+                int * row = L + (size_t)i * cols;
+                const int * up = i > r0 ? row - cols : 0;
+                for (int j = 0; j < cols; ++j) {
+                    if (!fg[j]) {
+                        row[j] = 0;
+                        continue;
+                    }
+                    int w = j > 0 ? row[j - 1] : 0;
+                    int n = up ? up[j] : 0;
+                    int l;
+                    if (conn == CONNECT_4) {
+                        l = n ? n : w;
+                        if (n && w && n != w)
+                            Union(p, n, w);
+                    }
+                    else if (n)
+                        // W y NE ya están unidos con N a través de la fila de arriba
+                        l = n;
+                    else {
+                        int ne = up && j + 1 < cols ? up[j + 1] : 0;
+                        int nw = up && j > 0 ? up[j - 1] : 0;
+                        // W y NW están unidos entre sí: basta con uno de ellos
+                        int left = w ? w : nw;
+                        l = ne ? ne : left;
+                        if (ne && left && ne != left)
+                            Union(p, ne, left);
+                    }
+                    if (!l) {
+                        l = next++;
+                        p[l].store(l, std::memory_order_relaxed);
+                    }
+                    row[j] = l;
+                }
+            }
+            used[b] = next - base;
+        }
+    }, 1);
+
+    // Uniones a través de las fronteras entre bandas
+    ParallelFor(nbands - 1, [&](int bbegin, int bend) {
+        for (int b = bbegin + 1; b < bend + 1; ++b) {
+            const int * row = L + (size_t)band_row[b] * cols;
+            const int * up = row - cols;
+            for (int j = 0; j < cols; ++j) {
+                if (!row[j])
+                    continue;
+                if (up[j])
+                    Union(p, row[j], up[j]);
+                else if (conn == CONNECT_8) {
+                    if (j > 0 && up[j - 1])
+                        Union(p, row[j], up[j - 1]);
+                    if (j + 1 < cols && up[j + 1])
+                        Union(p, row[j], up[j + 1]);
+                }
+            }
+        }
+    }, 1);
+
+    // Cada etiqueta apunta directamente a su raíz; las raíces quedan fijas a partir de aquí.
+    // Cada banda escribe solo sus entradas y siempre con la raíz, así que los recorridos de las
+    // demás siguen llegando a ella.
+    ParallelFor(nbands, [&](int bbegin, int bend) {
+        for (int b = bbegin; b < bend; ++b) {
+            const int base = (int)(band_row[b] * half + 1);
+            int n = 0;
+            for (int x = base; x < base + used[b]; ++x) {
+                int r = Root(p, x);
+                p[x].store(r, std::memory_order_relaxed);
+                n += r == x;
+            }
+            roots[b] = n;
+        }
+    }, 1);
+
+    first[0] = 0;
+    for (int b = 0; b < nbands; ++b)
+        first[b + 1] = first[b] + roots[b];
+
+    // Numeración de las raíces, guardada con signo negativo en su propia entrada
+    ParallelFor(nbands, [&](int bbegin, int bend) {
+        for (int b = bbegin; b < bend; ++b) {
+            const int base = (int)(band_row[b] * half + 1);
+            int id = first[b];
+            for (int x = base; x < base + used[b]; ++x)
+                if (p[x].load(std::memory_order_relaxed) == x)
+                    p[x].store(-(++id), std::memory_order_relaxed);
+        }
+    }, 1);
+
+    // Etiquetas definitivas y estadísticas. Cada banda acumula las de sus raíces, que tienen
+    // etiquetas seguidas; las componentes que vienen de una banda anterior tocan la primera fila
+    // de la banda, así que son como mucho cols y se acumulan aparte.
+    std::vector<Acc> acc(first[nbands]);
+    std::vector<std::unordered_map<int, Acc> > foreign(nbands);
+    ParallelFor(nbands, [&](int bbegin, int bend) {
+        for (int b = bbegin; b < bend; ++b) {
+            for (int i = band_row[b]; i < band_row[b + 1]; ++i) {
+                int * row = L + (size_t)i * cols;
+                for (int j = 0; j < cols; ) {
+                    if (!row[j]) {
+                        ++j;
+                        continue;
+                    }
+                    // Un tramo de píxeles seguidos es siempre de una sola componente
+                    int v = p[row[j]].load(std::memory_order_relaxed);
+                    const int id = v < 0 ? -v : -p[v].load(std::memory_order_relaxed);
+                    int j1 = j;
+                    for (; j1 < cols && row[j1]; ++j1)
+                        row[j1] = id;
+                    if (id > first[b])
+                        acc[id - 1].AddRun(i, j, j1);
+                    else
+                        foreign[b][id].AddRun(i, j, j1);
+                    j = j1;
+                }
+            }
+        }
+    }, 1);
+
+    for (int b = 0; b < nbands; ++b)
+        for (const auto & f : foreign[b])
+            acc[f.first - 1].Merge(f.second);
+    res.stats.resize(acc.size());
+    for (size_t k = 0; k < acc.size(); ++k)
+        res.stats[k] = acc[k].Stats();
+    return res;
+}
+
+// _____________________________________________________________________________
+
+LabelMap LabelComponents (const Image & image, Connectivity conn) {
+    IMAGE_PROFILE_SCOPE("LabelComponents");
+    IMAGE_PROFILE_PIXELS(image.size());
+    ImageRows rows = { image };
+    return LabelMap::Label(rows, conn);
+}
+
+LabelMap LabelComponents (const BitImage & mask, Connectivity conn) {
+    IMAGE_PROFILE_SCOPE("LabelComponents");
+    IMAGE_PROFILE_PIXELS((long long)mask.get_rows() * mask.get_cols());
+    MaskRows rows = { mask };
+    return LabelMap::Label(rows, conn);
+}
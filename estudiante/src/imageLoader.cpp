@@ -0,0 +1,292 @@
+/**
+ * @file imageLoader.cpp
+ * @brief Fichero con definiciones para la carga anticipada y el guardado asíncrono de imágenes
+ */
+
+#include <cerrno>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef IMAGE_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include <imageLoader.h>
+
+using namespace std;
+
+ImageLoader::ImageLoader (const vector<string> & paths, int prefetch, int nthreads)
+    : paths(paths), window(prefetch > 0 ? prefetch : 1), issued(0), consumed(0), stopping(false) {
+    for (Slot & s : window)
+        s.state = EMPTY;
+    if (nthreads <= 0)
+        nthreads = (int)window.size();
+
+#ifdef IMAGE_HAVE_LIBURING
+    direct_reads = false;
+    reader = thread(&ImageLoader::ReaderLoop, this);
+#else
+    direct_reads = true;
+#endif
+    for (int t = 0; t < nthreads; ++t)
+        workers.emplace_back(&ImageLoader::WorkerLoop, this);
+}
+
+ImageLoader::~ImageLoader (){
+    {
+        lock_guard<mutex> lk(m);
+        stopping = true;
+    }
+    work.notify_all();
+    if (reader.joinable())
+        reader.join();
+    for (thread & t : workers)
+        t.join();
+}
+
+const char * ImageLoader::Backend (){
+#ifdef IMAGE_HAVE_LIBURING
+    return "io_uring";
+#else
+    return "threads";
+#endif
+}
+
+bool ImageLoader::CanIssue () const {
+    return issued < paths.size() && issued < consumed + window.size();
+}
+
+bool ImageLoader::Next (LoadedImage & item){
+    unique_lock<mutex> lk(m);
+    if (consumed >= paths.size())
+        return false;
+
+    Slot & s = window[consumed % window.size()];
+    ready.wait(lk, [&]() { return s.state == READY; });
+    item = move(s.item);
+    s.item = LoadedImage();
+    s.state = EMPTY;
+    ++consumed;
+    lk.unlock();
+
+    // Queda un hueco libre en la ventana: se puede leer otra imagen
+    work.notify_all();
+    return true;
+}
+
+future<bool> ImageLoader::SaveAsync (const Image & image, const string & path){
+    packaged_task<bool()> task([image, path]() { return image.Save(path.c_str()); });
+    future<bool> res = task.get_future();
+    {
+        lock_guard<mutex> lk(m);
+        saves.push_back(move(task));
+    }
+    work.notify_one();
+    return res;
+}
+
+// Cada hilo atiende, por orden de prioridad: guardados, decodificaciones y lecturas nuevas.
+// El slot de una imagen pertenece en exclusiva al hilo que la lee o decodifica, así que se
+// rellena sin tener el cerrojo; Next() solo lo toca cuando su estado es READY.
+void ImageLoader::WorkerLoop (){
+    unique_lock<mutex> lk(m);
+    for (;;){
+        work.wait(lk, [&]() {
+            return stopping || !saves.empty() || !decode.empty() || (direct_reads && CanIssue());
+        });
+
+        if (!saves.empty()){
+            packaged_task<bool()> task = move(saves.front());
+            saves.pop_front();
+            lk.unlock();
+            task();
+            lk.lock();
+        }
+        else if (stopping)
+            break;
+        else if (!decode.empty()){
+            Slot & s = window[decode.front() % window.size()];
+            decode.pop_front();
+            s.state = DECODING;
+            lk.unlock();
+            s.item.ok = s.item.image.LoadFromMemory(s.bytes.data(), s.bytes.size());
+            vector<unsigned char>().swap(s.bytes);
+            lk.lock();
+            s.state = READY;
+            ready.notify_all();
+        }
+        else {
+            size_t k = issued++;
+            Slot & s = window[k % window.size()];
+            s.state = READING;
+            lk.unlock();
+            s.item.path = paths[k];
+            s.item.ok = s.item.image.Load(paths[k].c_str());
+            lk.lock();
+            s.state = READY;
+            ready.notify_all();
+        }
+    }
+}
+
+#ifdef IMAGE_HAVE_LIBURING
+
+// Envía las lecturas de toda la ventana libre en un único lote y pasa los bytes a los
+// hilos de trabajo para que los decodifiquen.
+void ImageLoader::ReaderLoop (){
+    struct io_uring ring;
+    if (io_uring_queue_init((unsigned)window.size(), &ring, 0) < 0){
+        // El núcleo no admite io_uring (o está bloqueado): leen los hilos de trabajo
+        lock_guard<mutex> lk(m);
+        direct_reads = true;
+        work.notify_all();
+        return;
+    }
+
+    struct Request {
+        size_t k;
+        int fd;
+        size_t done;
+        bool ok;
+        bool inflight;  // hay una lectura enviada cuyo resultado no ha llegado
+    };
+    vector<Request> batch;
+
+    // Espera el siguiente resultado; las interrupciones se reintentan
+    auto wait = [&](struct io_uring_cqe ** cqe) {
+        int e;
+        do
+            e = io_uring_wait_cqe(&ring, cqe);
+        while (e == -EINTR || e == -EAGAIN);
+        return e;
+    };
+
+    bool broken = false;
+    while (!broken){
+        batch.clear();
+        {
+            unique_lock<mutex> lk(m);
+            work.wait(lk, [&]() { return stopping || CanIssue(); });
+            if (stopping)
+                break;
+            while (CanIssue()){
+                Request r = { issued++, -1, 0, true, false };
+                window[r.k % window.size()].state = READING;
+                batch.push_back(r);
+            }
+        }
+
+        // Las lecturas guardan un puntero a su Request: batch no cambia hasta que terminan todas
+        unsigned inflight = 0;
+        for (Request & r : batch){
+            Slot & s = window[r.k % window.size()];
+            s.item.path = paths[r.k];
+            struct stat st;
+            r.fd = open(paths[r.k].c_str(), O_RDONLY | O_CLOEXEC);
+            if (r.fd < 0 || fstat(r.fd, &st) != 0){
+                r.ok = false;
+                continue;
+            }
+            s.bytes.resize(st.st_size);
+            if (s.bytes.empty())
+                continue;
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+            io_uring_prep_read(sqe, r.fd, s.bytes.data(), (unsigned)s.bytes.size(), 0);
+            io_uring_sqe_set_data(sqe, &r);
+            r.inflight = true;
+            ++inflight;
+        }
+        io_uring_submit(&ring);
+
+        bool cancelled = false;
+        while (inflight > 0){
+            struct io_uring_cqe *cqe;
+            if (wait(&cqe) < 0){
+                if (cancelled){
+                    // Ni siquiera llegan las cancelaciones: el anillo está roto. Cerrarlo cancela
+                    // en el núcleo lo que quede pendiente; estas imágenes fallan y las siguientes
+                    // las leen los hilos de trabajo.
+                    broken = true;
+                    break;
+                }
+                // Antes de soltar los buffers hay que asegurarse de que el núcleo no escribirá en
+                // ellos: se cancelan las lecturas pendientes y se espera a que terminen
+                for (Request & r : batch)
+                    if (r.inflight){
+                        struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+                        if (!sqe){
+                            io_uring_submit(&ring);
+                            sqe = io_uring_get_sqe(&ring);
+                        }
+                        if (sqe){
+                            io_uring_prep_cancel(sqe, &r, 0);
+                            io_uring_sqe_set_data(sqe, 0);
+                        }
+                    }
+                io_uring_submit(&ring);
+                cancelled = true;
+                continue;
+            }
+            Request * req = static_cast<Request *>(io_uring_cqe_get_data(cqe));
+            int res = cqe->res;
+            io_uring_cqe_seen(&ring, cqe);
+            if (!req)
+                continue;   // resultado de una cancelación
+
+            Request & r = *req;
+            Slot & s = window[r.k % window.size()];
+            r.inflight = false;
+            --inflight;
+            if (res <= 0 || cancelled){
+                r.ok = false;
+                continue;
+            }
+            r.done += res;
+            if (r.done < s.bytes.size()){
+                // Lectura parcial: se pide el resto
+                struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+                io_uring_prep_read(sqe, r.fd, s.bytes.data() + r.done,
+                                   (unsigned)(s.bytes.size() - r.done), r.done);
+                io_uring_sqe_set_data(sqe, &r);
+                io_uring_submit(&ring);
+                r.inflight = true;
+                ++inflight;
+            }
+        }
+        if (broken)
+            io_uring_queue_exit(&ring);
+
+        lock_guard<mutex> lk(m);
+        for (Request & r : batch){
+            if (r.fd >= 0)
+                close(r.fd);
+            Slot & s = window[r.k % window.size()];
+            if (r.inflight)
+                new vector<unsigned char>(move(s.bytes));  // el núcleo aún podría escribir: se abandona
+            if (r.ok && !r.inflight){
+                s.state = READ;
+                decode.push_back(r.k);
+            }
+            else {
+                s.item.ok = false;
+                s.state = READY;
+            }
+        }
+        if (broken)
+            direct_reads = true;
+        work.notify_all();
+        ready.notify_all();
+    }
+
+    if (!broken)
+        io_uring_queue_exit(&ring);
+}
+
+#else
+
+void ImageLoader::ReaderLoop (){}
+
+#endif
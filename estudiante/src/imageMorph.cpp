@@ -0,0 +1,203 @@
+/**
+ * @file imageMorph.cpp
+ * @brief Fichero con definiciones para las operaciones morfológicas de la clase Image
+ *
+ * La erosión y la dilatación con un rectángulo son separables: se aplica el mínimo (o máximo)
+ * por filas con una ventana de la anchura del rectángulo, y al resultado por columnas con una
+ * ventana de su altura. Cada pasada usa el algoritmo de van Herk/Gil-Werman: la secuencia se
+ * divide en bloques del tamaño de la ventana y, con el mínimo acumulado hacia delante (g) y hacia
+ * atrás (h) de cada bloque, el mínimo de cualquier ventana es min(h[x], g[x + w - 1]). Son 3
+ * comparaciones por píxel sea cual sea el tamaño de la ventana.
+ *
+ * La pasada por columnas trabaja con filas enteras (el mínimo de dos filas píxel a píxel), que
+ * se calcula con los núcleos vectoriales de imageKernels.h. Para ventanas pequeñas es más rápido
+ * combinar directamente las w filas o columnas desplazadas.
+ */
+
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include <image.h>
+#include <imageKernels.h>
+#include <instrument.h>
+#include <parallel.h>
+
+namespace {
+
+// Ventanas de hasta este tamaño se calculan combinando directamente los w desplazamientos
+const int SMALL_WINDOW = 4;
+
+struct MinOp {
+    static byte Neutral () { return 255; }
+    static byte Apply (byte a, byte b) { return a < b ? a : b; }
+    static void Rows (const byte * a, const byte * b, byte * out, int n) { Kernels().pixel_min(a, b, out, n); }
+};
+
+struct MaxOp {
+    static byte Neutral () { return 0; }
+    static byte Apply (byte a, byte b) { return a > b ? a : b; }
+    static void Rows (const byte * a, const byte * b, byte * out, int n) { Kernels().pixel_max(a, b, out, n); }
+};
+
+// Filas de cada banda al repartir n filas de n_cols píxeles entre hilos
+int RowGrain (int n_cols) {
+    return std::max(1, (1 << 16) / std::max(n_cols, 1));
+}
+
+/*
+ * Pasada por filas: out[j] = Op sobre in[j - anchor .. j - anchor + w - 1], donde los píxeles
+ * fuera de la fila son el neutro de Op.
+ */
+template <class Op>
+void RowPass (const Image & src, Image & dst, int w, int anchor) {
+    const int cols = src.get_cols();
+    // Fila rellenada con el neutro, redondeada a un múltiplo de w
+    const int padded = (cols + w - 1 + w - 1) / w * w;
+
+    ParallelFor(src.get_rows(), [&](int begin, int end) {
+        std::vector<byte> pad(padded + w, Op::Neutral()), g(padded), h(padded);
+        for (int i = begin; i < end; ++i) {
+            const byte * in = src.get_row(i);
+            byte * out = dst.get_row(i);
+            memcpy(pad.data() + anchor, in, cols);
+
+            if (w <= SMALL_WINDOW) {
+                memcpy(out, pad.data(), cols);
+                for (int t = 1; t < w; ++t)
+                    Op::Rows(out, pad.data() + t, out, cols);
+                continue;
+            }
+
+            // Acumulados hacia delante y hacia atrás dentro de cada bloque de w píxeles
+            for (int b = 0; b < padded; b += w) {
+                g[b] = pad[b];
+                for (int k = b + 1; k < b + w; ++k)
+                    g[k] = Op::Apply(g[k - 1], pad[k]);
+                h[b + w - 1] = pad[b + w - 1];
+                for (int k = b + w - 2; k >= b; --k)
+                    h[k] = Op::Apply(h[k + 1], pad[k]);
+            }
+            Op::Rows(h.data(), g.data() + w - 1, out, cols);
+        }
+    }, RowGrain(cols));
+}
+
+/*
+ * Pasada por columnas: la fila i de dst es Op sobre las filas i - anchor .. i - anchor + w - 1
+ * de src, donde las filas fuera de la imagen son el neutro de Op. Los bloques de w filas están
+ * alineados en coordenadas de la imagen rellenada (fila p <-> fila p - anchor de src).
+ */
+template <class Op>
+void ColumnPass (const Image & src, Image & dst, int w, int anchor) {
+    const int rows = src.get_rows(), cols = src.get_cols();
+    const std::vector<byte> neutral(cols, Op::Neutral());
+    auto padded_row = [&](int p) -> const byte * {
+        int r = p - anchor;
+        return r >= 0 && r < rows ? src.get_row(r) : neutral.data();
+    };
+
+    ParallelFor(rows, [&](int begin, int end) {
+        if (w <= SMALL_WINDOW) {
+            for (int i = begin; i < end; ++i) {
+                byte * out = dst.get_row(i);
+                memcpy(out, padded_row(i), cols);
+                for (int t = 1; t < w; ++t)
+                    Op::Rows(out, padded_row(i + t), out, cols);
+            }
+            return;
+        }
+
+        // h: acumulado hacia atrás del bloque actual; g: hacia delante del bloque siguiente
+        std::vector<byte> h((size_t)w * cols), g((size_t)w * cols);
+        for (int s = begin / w * w; s < end; s += w) {
+            memcpy(&h[(size_t)(w - 1) * cols], padded_row(s + w - 1), cols);
+            for (int k = w - 2; k >= 0; --k)
+                Op::Rows(&h[(size_t)(k + 1) * cols], padded_row(s + k), &h[(size_t)k * cols], cols);
+            memcpy(&g[0], padded_row(s + w), cols);
+            for (int k = 1; k < w - 1; ++k)
+                Op::Rows(&g[(size_t)(k - 1) * cols], padded_row(s + w + k), &g[(size_t)k * cols], cols);
+
+            // La ventana que empieza en la fila i = s + k cubre h[k] y g[k - 1]
+            for (int i = std::max(s, begin); i < std::min(s + w, end); ++i) {
+                int k = i - s;
+                if (k == 0)
+                    memcpy(dst.get_row(i), &h[0], cols);
+                else
+                    Op::Rows(&h[(size_t)k * cols], &g[(size_t)(k - 1) * cols], dst.get_row(i), cols);
+            }
+        }
+    }, RowGrain(cols));
+}
+
+// Op sobre la ventana de height x width píxeles cuya esquina superior izquierda está a
+// (anchor_r, anchor_c) píxeles por encima y a la izquierda de cada píxel
+template <class Op>
+Image Filter (const Image & src, int height, int width, int anchor_r, int anchor_c) {
+    Image tmp(src.get_rows(), src.get_cols()), res(src.get_rows(), src.get_cols());
+    if (src.Empty())
+        return res;
+    RowPass<Op>(src, tmp, width, anchor_c);
+    ColumnPass<Op>(tmp, res, height, anchor_r);
+    return res;
+}
+
+// Erosión con el rectángulo anclado en su centro
+Image ErodeRect (const Image & src, int height, int width) {
+    return Filter<MinOp>(src, height, width, height / 2, width / 2);
+}
+
+// Dilatación con el mismo rectángulo: la ventana es la reflejada de la de la erosión, que solo
+// difiere de ella si alguna dimensión es par
+Image DilateRect (const Image & src, int height, int width) {
+    return Filter<MaxOp>(src, height, width, height - 1 - height / 2, width - 1 - width / 2);
+}
+
+// res[k] = a[k] - b[k], sabiendo que a[k] >= b[k]
+Image Difference (const Image & a, const Image & b) {
+    Image res(a.get_rows(), a.get_cols());
+    for (int i = 0; i < a.get_rows(); ++i) {
+        const byte * pa = a.get_row(i);
+        const byte * pb = b.get_row(i);
+        byte * out = res.get_row(i);
+        for (int j = 0; j < a.get_cols(); ++j)
+            out[j] = (byte)(pa[j] - pb[j]);
+    }
+    return res;
+}
+
+}
+
+// _____________________________________________________________________________
+
+Image Image::Erode(int height, int width) const {
+    IMAGE_PROFILE_SCOPE("Erode");
+    IMAGE_PROFILE_PIXELS(size());
+    return ErodeRect(*this, height, width);
+}
+
+Image Image::Dilate(int height, int width) const {
+    IMAGE_PROFILE_SCOPE("Dilate");
+    IMAGE_PROFILE_PIXELS(size());
+    return DilateRect(*this, height, width);
+}
+
+Image Image::Open(int height, int width) const {
+    IMAGE_PROFILE_SCOPE("Open");
+    IMAGE_PROFILE_PIXELS(size());
+    return DilateRect(ErodeRect(*this, height, width), height, width);
+}
+
+Image Image::Close(int height, int width) const {
+    IMAGE_PROFILE_SCOPE("Close");
+    IMAGE_PROFILE_PIXELS(size());
+    return ErodeRect(DilateRect(*this, height, width), height, width);
+}
+
+Image Image::MorphGradient(int height, int width) const {
+    return Difference(Dilate(height, width), Erode(height, width));
+}
+
+Image Image::TopHat(int height, int width) const {
+    return Difference(*this, Open(height, width));
+}
@@ -0,0 +1,621 @@
+/**
+ * @file imageServer.cpp
+ * @brief Fichero con definiciones para el servidor de operaciones sobre imágenes y su cliente
+ */
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <imageServer.h>
+#include <instrument.h>
+#include <parallel.h>
+
+using namespace std;
+
+namespace {
+
+// Llena la dirección del socket; falla si la ruta no cabe
+bool MakeAddress (const string & path, struct sockaddr_un & addr){
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        return false;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+/*
+ * Envía un mensaje: la cabecera, los píxeles que van en el propio mensaje y, si pass_fd >= 0,
+ * ese descriptor adjunto. Con MSG_DONTWAIT falla con EAGAIN si el mensaje no cabe en el socket.
+ */
+bool SendMessage (int fd, const void * header, size_t hlen, const vector<unsigned char> & payload, int pass_fd, int flags){
+    struct iovec iov[2] = {
+        { const_cast<void *>(header), hlen },
+        { const_cast<unsigned char *>(payload.data()), payload.size() }
+    };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = payload.empty() ? 1 : 2;
+    if (pass_fd >= 0){
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        struct cmsghdr * c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(c), &pass_fd, sizeof(int));
+    }
+
+    ssize_t w;
+    do
+        w = sendmsg(fd, &msg, MSG_NOSIGNAL | flags);
+    while (w < 0 && errno == EINTR);
+    return w == (ssize_t)(hlen + payload.size());
+}
+
+/*
+ * Recibe un mensaje completo. Devuelve el número de bytes recibidos, 0 si el otro extremo
+ * cerró la conexión o -1 si hubo un error (EAGAIN si se pidió MSG_DONTWAIT y no había nada).
+ * Los mensajes que no caben o no traen la cabecera entera se descartan con EBADMSG.
+ */
+ssize_t RecvMessage (int fd, void * header, size_t hlen, vector<unsigned char> & payload, int & passed, int flags){
+    payload.resize(SERVER_INLINE_PIXELS);
+    struct iovec iov[2] = { { header, hlen }, { payload.data(), payload.size() } };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t r;
+    do
+        r = recvmsg(fd, &msg, flags | MSG_CMSG_CLOEXEC);
+    while (r < 0 && errno == EINTR);
+
+    passed = -1;
+    if (r > 0)
+        for (struct cmsghdr * c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS)
+                memcpy(&passed, CMSG_DATA(c), sizeof(int));
+    if (r > 0 && ((msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || (size_t)r < hlen)){
+        if (passed >= 0)
+            close(passed);
+        passed = -1;
+        errno = EBADMSG;
+        return -1;
+    }
+    payload.resize(r > (ssize_t)hlen ? r - hlen : 0);
+    return r;
+}
+
+// Los memfd se sellan contra cambios de tamaño: quien los proyecta no puede recibir SIGBUS porque
+// el otro extremo los acorte
+const int MEMFD_SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+
+void Unmap (byte * data, size_t size){
+    munmap(data, size);
+}
+
+// Dimensiones que puede tener una imagen: como en ParsePNMHeader, el número de píxeles cabe en un int
+bool ValidSize (int rows, int cols){
+    return rows > 0 && cols > 0 && rows <= PNM_MAX_DIMENSION && cols <= PNM_MAX_DIMENSION
+           && (long long)rows * cols <= INT_MAX;
+}
+
+/*
+ * Proyecta un memfd como imagen de rows x cols, sin copiar sus píxeles. Solo se admiten memfd
+ * sellados contra cambios de tamaño: F_GET_SEALS falla con cualquier otro descriptor, como un
+ * fichero normal que el otro extremo podría acortar o que se modificaría en su sitio.
+ */
+bool MapImage (int fd, int rows, int cols, Image & out){
+    const size_t size = (size_t)rows * cols;
+    if (fd < 0)
+        return false;
+    const int seals = fcntl(fd, F_GET_SEALS);
+    struct stat st;
+    if (seals < 0 || (seals & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW)
+        || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size != size)
+        return false;
+    void * addr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+        return false;
+    out = Image::Wrap(rows, cols, static_cast<byte *>(addr), Unmap);
+    return true;
+}
+
+/*
+ * Crea una imagen de rows x cols a 0 para escribir el resultado de una operación. Si es grande sus
+ * píxeles están en un memfd nuevo, que se devuelve en @a memfd, para enviarla sin copiarla.
+ */
+bool NewImage (int rows, int cols, Image & out, int & memfd){
+    memfd = -1;
+    if ((size_t)rows * cols <= (size_t)SERVER_INLINE_PIXELS){
+        out = Image(rows, cols);
+        return true;
+    }
+    memfd = memfd_create("image", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd >= 0 && ftruncate(memfd, (size_t)rows * cols) == 0 && fcntl(memfd, F_ADD_SEALS, MEMFD_SEALS) == 0
+        && MapImage(memfd, rows, cols, out))
+        return true;
+    if (memfd >= 0)
+        close(memfd);
+    memfd = -1;
+    return false;
+}
+
+/*
+ * Prepara los píxeles de una imagen para enviarlos. Si @a memfd >= 0 la imagen ya está en ese
+ * memfd y no hay que hacer nada; si no, las pequeñas van en @a payload y las grandes se copian a
+ * un memfd nuevo, que se devuelve en @a memfd. Devuelve los flags de la cabecera, o -1 si no pudo
+ * crearse el memfd.
+ */
+int EncodePixels (const Image & image, vector<unsigned char> & payload, int & memfd){
+    const int rows = image.get_rows(), cols = image.get_cols();
+    const size_t size = (size_t)rows * cols;
+    payload.clear();
+    if (memfd >= 0)
+        return PAYLOAD_MEMFD;
+    if (size <= (size_t)SERVER_INLINE_PIXELS){
+        payload.resize(size);
+        for (int i = 0; i < rows; ++i)
+            memcpy(&payload[(size_t)i * cols], image.get_row(i), cols);
+        return 0;
+    }
+
+    Image copy;
+    if (!NewImage(rows, cols, copy, memfd))
+        return -1;
+    copy.PaintIn(image, 0, 0);
+    return PAYLOAD_MEMFD;
+}
+
+// Reconstruye una imagen recibida, desde el propio mensaje o proyectando el memfd adjunto
+bool DecodePixels (int rows, int cols, uint8_t flags, const vector<unsigned char> & payload, int fd, Image & out){
+    if (!ValidSize(rows, cols))
+        return false;
+    if (flags & PAYLOAD_MEMFD)
+        return MapImage(fd, rows, cols, out);
+
+    if (payload.size() != (size_t)rows * cols)
+        return false;
+    out = Image(rows, cols);
+    for (int i = 0; i < rows; ++i)
+        memcpy(out.get_row(i), &payload[(size_t)i * cols], cols);
+    return true;
+}
+
+/*
+ * Aplica la operación pedida, comprobando antes sus parámetros. Las operaciones que no cambian
+ * el tamaño se hacen sobre la propia entrada, y el resultado sigue en su memfd @a fd si lo
+ * tenía; las que lo cambian escriben en una imagen nueva, en un memfd nuevo si es grande. En
+ * ambos casos @a fd queda con el memfd del resultado o -1, y el de la entrada se cierra si no
+ * es el mismo.
+ */
+bool Apply (const ServerRequest & req, Image & in, Image & out, int & fd){
+    const int rows = in.get_rows(), cols = in.get_cols();
+    const int * a = req.args;
+    int out_fd = -1;
+    bool ok = true;
+    switch (req.op){
+        case OP_INVERT:
+            in.Invert();
+            out = move(in);
+            swap(fd, out_fd);
+            break;
+        case OP_CROP:
+            ok = a[0] >= 0 && a[0] < rows && a[1] >= 0 && a[1] < cols && ValidSize(a[2], a[3])
+                 && NewImage(a[2], a[3], out, out_fd);
+            if (ok)
+                out.PaintIn(in, -a[0], -a[1]);
+            break;
+        case OP_ZOOM:
+            ok = a[0] >= 0 && a[0] < rows && a[1] >= 0 && a[1] < cols && a[2] > 0 && a[2] <= PNM_MAX_DIMENSION / 2
+                 && ValidSize(2 * a[2] - 1, 2 * a[2] - 1) && NewImage(2 * a[2] - 1, 2 * a[2] - 1, out, out_fd);
+            if (ok)
+                in.CropView(a[0], a[1], a[2], a[2]).Zoom2X(out);
+            break;
+        case OP_SUBSAMPLE:
+            // El icono es como mucho la cuarta parte de la entrada salvo con factor 1: no compensa
+            // escribirlo directamente en un memfd
+            ok = a[0] > 0 && a[0] <= rows && a[0] <= cols;
+            if (ok)
+                out = in.Subsample(a[0]);
+            break;
+        case OP_CONTRAST:
+            for (int k = 0; k < 4; ++k)
+                ok = ok && a[k] >= 0 && a[k] <= 255;
+            ok = ok && a[0] < a[1];
+            if (ok){
+                in.AdjustContrast(a[0], a[1], a[2], a[3]);
+                out = move(in);
+                swap(fd, out_fd);
+            }
+            break;
+        default:
+            ok = false;
+    }
+    if (fd >= 0)
+        close(fd);
+    fd = out_fd;
+    return ok;
+}
+
+}
+
+// _____________________________________________________________________________
+
+struct ImageServer::Connection {
+
+    // Respuesta que aún no cabe en el socket
+    struct Reply {
+        ServerResponse res;
+        vector<unsigned char> payload;
+        int fd;     // memfd adjunto, o -1
+    };
+
+    int fd;
+    mutex m;            // protege lo que sigue
+    deque<Reply> out;   // respuestas a la espera de sitio en el socket, en orden
+    int pending;        // peticiones recibidas cuya respuesta no ha salido aún
+    bool broken;        // falló un envío: la conexión ya no se atiende
+
+    explicit Connection (int fd) : fd(fd), pending(0), broken(false) {}
+
+    ~Connection (){
+        Drop();
+        close(fd);
+    }
+
+    // Envía sin bloquear las respuestas encoladas que quepan. Requiere tener m.
+    void Flush (){
+        while (!broken && !out.empty()){
+            Reply & r = out.front();
+            if (!SendMessage(fd, &r.res, sizeof(r.res), r.payload, r.fd, MSG_DONTWAIT)){
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    broken = true;
+                break;
+            }
+            if (r.fd >= 0)
+                close(r.fd);
+            out.pop_front();
+            --pending;
+        }
+        if (broken)
+            Drop();
+    }
+
+    // Descarta las respuestas encoladas
+    void Drop (){
+        for (Reply & r : out)
+            if (r.fd >= 0)
+                close(r.fd);
+        pending -= (int)out.size();
+        out.clear();
+    }
+};
+
+const int ImageServer::SERVER_BATCH;
+const int ImageServer::SERVER_PENDING;
+
+ImageServer::ImageServer (const string & path, int workers)
+    : path(path), nworkers(workers > 0 ? workers : (int)max(1u, thread::hardware_concurrency())),
+      listen_fd(-1), wake_fd(-1), stopping(false), served(0), done(false) {}
+
+ImageServer::~ImageServer (){
+    if (listen_fd >= 0){
+        close(listen_fd);
+        unlink(path.c_str());
+    }
+    if (wake_fd >= 0)
+        close(wake_fd);
+}
+
+bool ImageServer::Start (){
+    struct sockaddr_un addr;
+    if (!MakeAddress(path, addr))
+        return false;
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (listen_fd < 0 || wake_fd < 0)
+        return false;
+    unlink(path.c_str());
+    return bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && listen(listen_fd, SOMAXCONN) == 0;
+}
+
+void ImageServer::Stop (){
+    stopping = true;
+    Wake();
+}
+
+void ImageServer::Wake (){
+    uint64_t one = 1;
+    while (write(wake_fd, &one, sizeof(one)) < 0 && errno == EINTR)
+        ;
+}
+
+void ImageServer::Run (){
+    vector<thread> workers;
+    for (int t = 0; t < nworkers; ++t)
+        workers.emplace_back([this]() { Work(); });
+
+    vector<shared_ptr<Connection>> conns;
+    vector<struct pollfd> fds;
+    vector<Job> received;
+    while (!stopping){
+        fds.assign(2 + conns.size(), pollfd());
+        fds[0] = { wake_fd, POLLIN, 0 };
+        fds[1] = { listen_fd, POLLIN, 0 };
+        // Una conexión con SERVER_PENDING peticiones sin responder no se lee hasta que su
+        // cliente recoja respuestas; las que tienen respuestas encoladas esperan sitio para ellas
+        for (size_t c = 0; c < conns.size(); ++c){
+            Connection & conn = *conns[c];
+            lock_guard<mutex> lock(conn.m);
+            short events = conn.pending < SERVER_PENDING ? POLLIN : 0;
+            if (!conn.out.empty())
+                events |= POLLOUT;
+            fds[2 + c] = { conn.fd, events, 0 };
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0){
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[0].revents){
+            uint64_t n;
+            while (read(wake_fd, &n, sizeof(n)) < 0 && errno == EINTR)
+                ;
+            if (stopping)
+                break;
+        }
+
+        // Todas las peticiones que ya han llegado, de todas las conexiones, se encolan de una vez
+        received.clear();
+        vector<char> closed(conns.size(), 0);
+        for (size_t c = 0; c < conns.size(); ++c){
+            const short revents = fds[2 + c].revents;
+            if (!revents)
+                continue;
+            Connection & conn = *conns[c];
+            int room;
+            {
+                lock_guard<mutex> lock(conn.m);
+                if (revents & POLLOUT)
+                    conn.Flush();
+                room = conn.broken ? -1 : SERVER_PENDING - conn.pending;
+            }
+            // Sin sitio no se lee; si el cliente se fue, ya no hay a quién responder
+            if (room < 0 || (room == 0 && (revents & (POLLHUP | POLLERR | POLLNVAL)))){
+                closed[c] = 1;
+                continue;
+            }
+            if (room == 0 || !(revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)))
+                continue;
+            int got = 0;
+            while (got < room){
+                Job job;
+                job.conn = conns[c];
+                ssize_t r = RecvMessage(conn.fd, &job.req, sizeof(job.req), job.pixels, job.fd, MSG_DONTWAIT);
+                if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    break;
+                if (r <= 0 || job.req.magic != SERVER_MAGIC){
+                    if (r > 0 && job.fd >= 0)
+                        close(job.fd);
+                    closed[c] = 1;
+                    break;
+                }
+                received.push_back(move(job));
+                ++got;
+            }
+            lock_guard<mutex> lock(conn.m);
+            conn.pending += got;
+        }
+        if (!received.empty()){
+            {
+                lock_guard<mutex> lock(m);
+                for (Job & job : received)
+                    queue.push_back(move(job));
+            }
+            ready.notify_all();
+        }
+
+        // Las conexiones cerradas se sueltan; las peticiones encoladas mantienen viva la suya
+        size_t kept = 0;
+        for (size_t c = 0; c < conns.size(); ++c)
+            if (!closed[c])
+                conns[kept++] = conns[c];
+        conns.resize(kept);
+
+        if (fds[1].revents & POLLIN){
+            int fd = accept4(listen_fd, 0, 0, SOCK_CLOEXEC);
+            if (fd >= 0)
+                conns.push_back(make_shared<Connection>(fd));
+        }
+    }
+
+    {
+        lock_guard<mutex> lock(m);
+        done = true;
+    }
+    ready.notify_all();
+    for (thread & w : workers)
+        w.join();
+}
+
+void ImageServer::Work (){
+    vector<Job> batch;
+    while (true){
+        batch.clear();
+        {
+            unique_lock<mutex> lock(m);
+            ready.wait(lock, [this]() { return done || !queue.empty(); });
+            if (queue.empty())
+                return;
+
+            // Una petición pequeña se lleva consigo las pequeñas que la siguen en la cola
+            auto small = [](const Job & job) { return !(job.req.flags & PAYLOAD_MEMFD); };
+            batch.push_back(move(queue.front()));
+            queue.pop_front();
+            while (small(batch.front()) && (int)batch.size() < SERVER_BATCH && !queue.empty() && small(queue.front())){
+                batch.push_back(move(queue.front()));
+                queue.pop_front();
+            }
+        }
+        for (Job & job : batch)
+            Serve(job);
+    }
+}
+
+void ImageServer::Serve (Job & job){
+    IMAGE_PROFILE_SCOPE("ImageServer::Serve");
+    ServerResponse res;
+    memset(&res, 0, sizeof(res));
+    res.magic = SERVER_MAGIC;
+    res.id = job.req.id;
+    res.status = STATUS_BAD_REQUEST;
+
+    // Los píxeles grandes se usan y se devuelven en memfd proyectados, sin copiarlos
+    Image in, out;
+    int memfd = job.fd;
+    job.fd = -1;
+    bool ok = DecodePixels(job.req.rows, job.req.cols, job.req.flags, job.pixels, memfd, in);
+    ok = ok && Apply(job.req, in, out, memfd);
+
+    vector<unsigned char> payload;
+    if (ok){
+        int flags = EncodePixels(out, payload, memfd);
+        if (flags < 0)
+            res.status = STATUS_ERROR;
+        else {
+            res.status = STATUS_OK;
+            res.flags = (uint8_t)flags;
+            res.rows = out.get_rows();
+            res.cols = out.get_cols();
+        }
+    }
+    if (!ok && memfd >= 0){
+        close(memfd);
+        memfd = -1;
+    }
+
+    // La respuesta nunca bloquea al hilo: si no cabe en el socket se encola y la envía Run()
+    Connection & conn = *job.conn;
+    bool wake;
+    {
+        lock_guard<mutex> lock(conn.m);
+        const bool was_full = conn.pending >= SERVER_PENDING, was_empty = conn.out.empty(), was_broken = conn.broken;
+        Connection::Reply reply = { res, move(payload), memfd };
+        conn.out.push_back(move(reply));
+        conn.Flush();
+        wake = (was_empty && !conn.out.empty()) || (was_full && conn.pending < SERVER_PENDING) || (!was_broken && conn.broken);
+    }
+    if (wake)
+        Wake();
+    ++served;
+}
+
+// _____________________________________________________________________________
+
+ImageClient::ImageClient () : fd(-1), next_id(1) {}
+
+ImageClient::~ImageClient (){
+    Close();
+}
+
+bool ImageClient::Connect (const string & path){
+    Close();
+    struct sockaddr_un addr;
+    if (!MakeAddress(path, addr))
+        return false;
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+        return true;
+    Close();
+    return false;
+}
+
+void ImageClient::Close (){
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+}
+
+uint32_t ImageClient::Send (ServerOp op, const Image & in, const int args[4]){
+    if (fd < 0 || in.Empty())
+        return 0;
+
+    ServerRequest req;
+    memset(&req, 0, sizeof(req));
+    req.magic = SERVER_MAGIC;
+    req.id = next_id++;
+    if (next_id == 0)
+        next_id = 1;
+    req.op = op;
+    req.rows = in.get_rows();
+    req.cols = in.get_cols();
+    memcpy(req.args, args, sizeof(req.args));
+
+    vector<unsigned char> payload;
+    int memfd = -1;
+    int flags = EncodePixels(in, payload, memfd);
+    if (flags < 0)
+        return 0;
+    req.flags = (uint8_t)flags;
+    bool ok = SendMessage(fd, &req, sizeof(req), payload, memfd, 0);
+    if (memfd >= 0)
+        close(memfd);
+    return ok ? req.id : 0;
+}
+
+ServerStatus ImageClient::Receive (uint32_t & id, Image & out){
+    ServerResponse res;
+    vector<unsigned char> payload;
+    int passed;
+    ssize_t r = RecvMessage(fd, &res, sizeof(res), payload, passed, 0);
+    if (r <= 0 || res.magic != SERVER_MAGIC){
+        if (passed >= 0)
+            close(passed);
+        return STATUS_ERROR;
+    }
+    id = res.id;
+
+    ServerStatus status = (ServerStatus)res.status;
+    if (status == STATUS_OK && !DecodePixels(res.rows, res.cols, res.flags, payload, passed, out))
+        status = STATUS_ERROR;
+    if (passed >= 0)
+        close(passed);
+    return status;
+}
+
+bool ImageClient::Call (ServerOp op, const Image & in, const int args[4], Image & out){
+    uint32_t id = Send(op, in, args), got = 0;
+    if (id == 0)
+        return false;
+    ServerStatus status;
+    do
+        status = Receive(got, out);
+    while (got != id && status != STATUS_ERROR);
+    return got == id && status == STATUS_OK;
+}
@@ -0,0 +1,196 @@
+/**
+ * @file imageThreshold.cpp
+ * @brief Fichero con definiciones para la binarización de la clase Image
+ *
+ * La binarización adaptativa necesita la suma y la suma de cuadrados de la ventana de cada
+ * píxel. Se obtienen de una imagen integral (I[y][x] = suma de los píxeles de arriba a la
+ * izquierda de (y, x)) con cuatro accesos por ventana, sea cual sea su tamaño. Para no guardar
+ * la integral de toda la imagen, cada banda de filas construye la de sus filas más el margen de
+ * la ventana por arriba y por abajo.
+ */
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include <image.h>
+#include <bitImage.h>
+#include <imageKernels.h>
+#include <instrument.h>
+#include <parallel.h>
+
+namespace {
+
+// Filas de salida de cada banda de la binarización adaptativa, como mínimo
+const int ADAPTIVE_BAND = 64;
+
+/*
+ * Binariza @a src con un umbral por píxel y entrega cada fila del resultado, con 255 en los
+ * píxeles mayores que su umbral y 0 en el resto, llamando a sink(i, fila).
+ */
+template <class Sink>
+void AdaptiveRows (const Image & src, AdaptiveMethod method, int window, double k, Sink sink) {
+    const int rows = src.get_rows(), cols = src.get_cols();
+    const int before = window / 2, after = window - 1 - window / 2;
+    const int band = std::max(ADAPTIVE_BAND, window);
+    const int nbands = (rows + band - 1) / band;
+    const size_t stride = cols + 1;
+
+    ParallelFor(nbands, [&](int bbegin, int bend) {
+        std::vector<unsigned long long> sum, sq;
+        std::vector<byte> out(cols);
+
+        for (int b = bbegin; b < bend; ++b) {
+            const int i0 = b * band, i1 = std::min(rows, i0 + band);
+            const int top = std::max(0, i0 - before), bottom = std::min(rows, i1 + after);
+
+            // Integrales de las filas top .. bottom - 1; la fila y de la tabla es la top + y - 1
+            sum.assign((size_t)(bottom - top + 1) * stride, 0);
+            sq.assign((size_t)(bottom - top + 1) * stride, 0);
+            for (int y = 1; y <= bottom - top; ++y) {
+                const byte * in = src.get_row(top + y - 1);
+                unsigned long long rs = 0, rq = 0;
+                unsigned long long * s = &sum[y * stride], * q = &sq[y * stride];
+                const unsigned long long * s_up = s - stride, * q_up = q - stride;
+                for (int x = 0; x < cols; ++x) {
+                    rs += in[x];
+                    rq += (unsigned)in[x] * in[x];
+                    s[x + 1] = s_up[x + 1] + rs;
+                    q[x + 1] = q_up[x + 1] + rq;
+                }
+            }
+
+            for (int i = i0; i < i1; ++i) {
+                const byte * in = src.get_row(i);
+                const int y0 = std::max(0, i - before) - top, y1 = std::min(rows, i + after + 1) - top;
+                const unsigned long long * s0 = &sum[y0 * stride], * s1 = &sum[y1 * stride];
+                const unsigned long long * q0 = &sq[y0 * stride], * q1 = &sq[y1 * stride];
+
+                for (int j = 0; j < cols; ++j) {
+                    const int x0 = std::max(0, j - before), x1 = std::min(cols, j + after + 1);
+                    const double area = (double)(y1 - y0) * (x1 - x0);
+                    const double mean = (s1[x1] - s1[x0] - s0[x1] + s0[x0]) / area;
+                    double t;
+                    if (method == SAUVOLA) {
+                        double var = (q1[x1] - q1[x0] - q0[x1] + q0[x0]) / area - mean * mean;
+                        t = mean * (1 + k * (std::sqrt(std::max(var, 0.0)) / 128 - 1));
+                    }
+                    else
+                        t = mean * (1 - k);
+                    out[j] = in[j] > t ? 255 : 0;
+                }
+                sink(i, out.data());
+            }
+        }
+    }, 1);
+}
+
+}
+
+// _____________________________________________________________________________
+
+void Image::Histogram(unsigned long long hist[256]) const {
+    IMAGE_PROFILE_SCOPE("Histogram");
+    IMAGE_PROFILE_PIXELS(size());
+    std::fill(hist, hist + 256, 0ull);
+    std::mutex m;
+
+    ParallelFor(rows, [&](int begin, int end) {
+        // Cuatro histogramas parciales: los píxeles iguales seguidos no esperan unos a otros
+        std::vector<unsigned> part(4 * 256, 0);
+        for (int i = begin; i < end; ++i) {
+            const byte * in = get_row(i);
+            int j = 0;
+            for (; j + 4 <= cols; j += 4) {
+                part[in[j]]++;
+                part[256 + in[j + 1]]++;
+                part[512 + in[j + 2]]++;
+                part[768 + in[j + 3]]++;
+            }
+            for (; j < cols; ++j)
+                part[in[j]]++;
+        }
+
+        std::lock_guard<std::mutex> lk(m);
+        for (int v = 0; v < 256; ++v)
+            hist[v] += (unsigned long long)part[v] + part[256 + v] + part[512 + v] + part[768 + v];
+    }, std::max(1, (1 << 16) / std::max(cols, 1)));
+}
+
+byte Image::OtsuThreshold() const {
+    unsigned long long hist[256];
+    Histogram(hist);
+
+    double total = 0, sum_total = 0;
+    for (int v = 0; v < 256; ++v) {
+        total += hist[v];
+        sum_total += (double)v * hist[v];
+    }
+
+    // Varianza entre clases de {<= t} y {> t}, salvo el factor constante 1 / total^2
+    double w_low = 0, sum_low = 0, best = -1;
+    int best_t = 0;
+    for (int t = 0; t < 255; ++t) {
+        w_low += hist[t];
+        sum_low += (double)t * hist[t];
+        double w_high = total - w_low;
+        if (w_low == 0)
+            continue;
+        if (w_high == 0)
+            break;
+        double diff = sum_low / w_low - (sum_total - sum_low) / w_high;
+        double between = w_low * w_high * diff * diff;
+        if (between > best) {
+            best = between;
+            best_t = t;
+        }
+    }
+    return (byte)best_t;
+}
+
+Image Image::Threshold(byte t) const {
+    IMAGE_PROFILE_SCOPE("Threshold");
+    IMAGE_PROFILE_PIXELS(size());
+    Image res(rows, cols);
+    const KernelTable & k = Kernels();
+    ParallelFor(rows, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            k.threshold(get_row(i), res.get_row(i), cols, t);
+    }, std::max(1, (1 << 16) / std::max(cols, 1)));
+    return res;
+}
+
+BitImage Image::ThresholdBits(byte t) const {
+    IMAGE_PROFILE_SCOPE("ThresholdBits");
+    IMAGE_PROFILE_PIXELS(size());
+    BitImage res(rows, cols);
+    const KernelTable & k = Kernels();
+    ParallelFor(rows, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            k.pack_threshold(get_row(i), res.get_row(i), cols, t);
+    }, std::max(1, (1 << 16) / std::max(cols, 1)));
+    return res;
+}
+
+Image Image::AdaptiveThreshold(AdaptiveMethod method, int window, double k) const {
+    IMAGE_PROFILE_SCOPE("AdaptiveThreshold");
+    IMAGE_PROFILE_PIXELS(size());
+    Image res(rows, cols);
+    AdaptiveRows(*this, method, window, k, [&](int i, const byte * row) {
+        memcpy(res.get_row(i), row, cols);
+    });
+    return res;
+}
+
+BitImage Image::AdaptiveThresholdBits(AdaptiveMethod method, int window, double k) const {
+    IMAGE_PROFILE_SCOPE("AdaptiveThresholdBits");
+    IMAGE_PROFILE_PIXELS(size());
+    BitImage res(rows, cols);
+    const KernelTable & kt = Kernels();
+    AdaptiveRows(*this, method, window, k, [&](int i, const byte * row) {
+        kt.pack_threshold(row, res.get_row(i), cols, 127);
+    });
+    return res;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file imageWarp.cpp
+ * @brief Fichero con definiciones para las transformaciones afines de la clase Image
+ *
+ * Cada fila del resultado recorre la original en línea recta, así que la posición de cada
+ * píxel se obtiene de la del anterior sumando un incremento constante en punto fijo. Con un giro
+ * esa línea cruza muchas filas de la original; para que las filas cercanas del resultado lean
+ * los mismos datos mientras siguen en caché, se recorren por bloques de WARP_TILE_ROWS filas y
+ * WARP_TILE_COLS columnas. Al empezar cada tramo de fila la posición se recalcula con la matriz,
+ * así que el error acumulado del punto fijo no pasa de WARP_TILE_COLS incrementos.
+ *
+ * La interpolación bilineal reúne primero los cuatro vecinos y los pesos de todo el tramo y
+ * después los combina con los núcleos lerp_q8 y blend_q8.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include <image.h>
+#include <imageKernels.h>
+#include <instrument.h>
+#include <parallel.h>
+
+namespace {
+
+// Dimensiones de los bloques del resultado
+const int WARP_TILE_ROWS = 32;
+const int WARP_TILE_COLS = 256;
+
+// Bits de fracción de las posiciones
+const int WARP_FRAC = 16;
+
+int64_t ToFixed (double v) {
+    return std::llround(v * (1 << WARP_FRAC));
+}
+
+}
+
+// _____________________________________________________________________________
+
+Image Image::Warp(const double m[6], Interpolation interp, byte fill) const {
+    IMAGE_PROFILE_SCOPE("Warp");
+    IMAGE_PROFILE_PIXELS(size());
+    Image res(rows, cols);
+    const int64_t dx = ToFixed(m[0]), dy = ToFixed(m[3]);
+    const KernelTable & k = Kernels();
+
+    ParallelFor(rows, [&](int begin, int end) {
+        byte p00[WARP_TILE_COLS], p01[WARP_TILE_COLS], p10[WARP_TILE_COLS], p11[WARP_TILE_COLS];
+        uint16_t wx[WARP_TILE_COLS], wy[WARP_TILE_COLS], top[WARP_TILE_COLS], bottom[WARP_TILE_COLS];
+
+        // Valor de la original en (y, x), o fill si cae fuera
+        auto at = [&](int64_t y, int64_t x) -> byte {
+            return y >= 0 && y < rows && x >= 0 && x < cols ? img[y][x] : fill;
+        };
+
+        for (int i0 = begin; i0 < end; i0 += WARP_TILE_ROWS)
+            for (int j0 = 0; j0 < cols; j0 += WARP_TILE_COLS) {
+                const int n = std::min(WARP_TILE_COLS, cols - j0);
+                for (int i = i0; i < std::min(i0 + WARP_TILE_ROWS, end); ++i) {
+                    int64_t x = ToFixed(m[0] * j0 + m[1] * i + m[2]);
+                    int64_t y = ToFixed(m[3] * j0 + m[4] * i + m[5]);
+                    byte * out = res.img[i] + j0;
+
+                    if (interp == NEAREST) {
+                        const int64_t half = 1 << (WARP_FRAC - 1);
+                        for (int t = 0; t < n; ++t, x += dx, y += dy)
+                            out[t] = at((y + half) >> WARP_FRAC, (x + half) >> WARP_FRAC);
+                        continue;
+                    }
+
+                    for (int t = 0; t < n; ++t, x += dx, y += dy) {
+                        const int64_t sx = x >> WARP_FRAC, sy = y >> WARP_FRAC;
+                        wx[t] = (uint16_t)((x >> (WARP_FRAC - 8)) & 0xFF);
+                        wy[t] = (uint16_t)((y >> (WARP_FRAC - 8)) & 0xFF);
+                        if (sy >= 0 && sy + 1 < rows && sx >= 0 && sx + 1 < cols) {
+                            const byte * r0 = img[sy] + sx, * r1 = img[sy + 1] + sx;
+                            p00[t] = r0[0];
+                            p01[t] = r0[1];
+                            p10[t] = r1[0];
+                            p11[t] = r1[1];
+                        }
+                        else {
+                            p00[t] = at(sy, sx);
+                            p01[t] = at(sy, sx + 1);
+                            p10[t] = at(sy + 1, sx);
+                            p11[t] = at(sy + 1, sx + 1);
+                        }
+                    }
+                    k.lerp_q8(p00, p01, wx, top, n);
+                    k.lerp_q8(p10, p11, wx, bottom, n);
+                    k.blend_q8(top, bottom, wy, out, n);
+                }
+            }
+    }, std::max(1, (1 << 16) / std::max(cols, 1)));
+    return res;
+}
+
+Image Image::Rotate(double degrees, Interpolation interp, byte fill) const {
+    // Matriz del giro inverso alrededor del centro: el pixel del resultado sale del de la
+    // original que, al girarlo, cae sobre el. Las filas crecen hacia abajo, de ahi los signos.
+    const double a = degrees * M_PI / 180, c = std::cos(a), s = std::sin(a);
+    const double cx = (cols - 1) / 2.0, cy = (rows - 1) / 2.0;
+    const double m[6] = {
+        c, -s, cx - c * cx + s * cy,
+        s,  c, cy - s * cx - c * cy
+    };
+    return Warp(m, interp, fill);
+}
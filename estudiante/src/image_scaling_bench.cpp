@@ -0,0 +1,193 @@
+/**
+ * @file Fichero image_scaling_bench.cpp, mide cómo escalan las operaciones de Image con el tamaño y los hilos
+ *
+ * Para imágenes cuadradas de lado 64 a 16384 (duplicando) y número de hilos de 1 hasta todos los
+ * núcleos, mide el tiempo de reloj de cada operación y escribe una línea por medida con el
+ * rendimiento (millones de píxeles de la imagen original por segundo), la aceleración y la
+ * eficiencia paralela respecto a un hilo, y el máximo de memoria
+ * residente del proceso hasta ese momento.
+ *
+ * La salida CSV se puede abrir directamente en una hoja de cálculo. Con "gnuplot" la salida se
+ * agrupa en un bloque por operación, separados por dos líneas en blanco, para dibujarla con
+ * plot 'fichero' index N.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <image.h>
+#include <fileIO.h>
+#include <parallel.h>
+
+using namespace std;
+
+// Píxeles que procesa como mínimo cada medida, repitiendo la operación en imágenes pequeñas
+const long long MIN_PIXELS_PER_SAMPLE = 32 << 20;
+const int SAMPLES = 3;
+
+struct Operation {
+    const char *name;
+    function<void(const Image &, Image &)> run;  // (original, imagen de trabajo)
+};
+
+struct Result {
+    string op;
+    int side, threads;
+    double seconds, mpixels, speedup, efficiency;
+    long rss_kb;
+};
+
+// Imagen sintética con gradientes y ruido, para que el códec no la trate como trivial
+Image Synthetic(int side) {
+    Image img(side, side);
+    unsigned state = 12345;
+    for (int i = 0; i < side; ++i) {
+        byte * row = img.get_row(i);
+        for (int j = 0; j < side; ++j) {
+            state = state * 1103515245u + 12345u;
+            row[j] = (byte)((i * 3 + j * 5) / 4 + ((state >> 16) & 15));
+        }
+    }
+    return img;
+}
+
+// Máximo de memoria residente del proceso, en KB
+long MaxRSS() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+// Mejor tiempo por ejecución, en segundos, de SAMPLES medidas de iters ejecuciones cada una
+double Measure(const Operation & op, const Image & src, Image & work, int iters) {
+    double best = 1e30;
+    for (int s = 0; s < SAMPLES; ++s) {
+        auto tini = chrono::steady_clock::now();
+        for (int k = 0; k < iters; ++k)
+            op.run(src, work);
+        double t = chrono::duration<double>(chrono::steady_clock::now() - tini).count() / iters;
+        if (t < best)
+            best = t;
+    }
+    return best;
+}
+
+int main (int argc, char *argv[]){
+
+    // Comprobar validez de la llamada
+    int max_side = argc > 1 ? atoi(argv[1]) : 16384;
+    bool gnuplot = argc > 2 && strcmp(argv[2], "gnuplot") == 0;
+    if (argc > 3 || max_side < 64 || (argc > 2 && !gnuplot && strcmp(argv[2], "csv") != 0)){
+        cerr << "Error: Numero incorrecto de parametros.\n";
+        cerr << "Uso: image_scaling_bench [lado_maximo] [csv|gnuplot]\n";
+        exit (1);
+    }
+
+    // Hilos a probar: potencias de dos y todos los núcleos
+    int ncores = (int)thread::hardware_concurrency();
+    if (ncores < 1)
+        ncores = 1;
+    vector<int> thread_counts;
+    for (int t = 1; t < ncores; t *= 2)
+        thread_counts.push_back(t);
+    thread_counts.push_back(ncores);
+
+    // Estado compartido por las operaciones de cada tamaño
+    vector<int> index;
+    vector<unsigned char> pgz;
+    string tmp = "/tmp/image_scaling_bench_" + to_string((long long)getpid()) + ".pgz";
+
+    const Operation ops[] = {
+        { "Copy+Detach", [](const Image & src, Image & work) { work = src; work.set_pixel(0, 0, 0); } },
+        { "Invert", [](const Image &, Image & work) { work.Invert(); } },
+        { "AdjustContrast", [](const Image &, Image & work) { work.AdjustContrast(64, 192, 32, 224); } },
+        { "Subsample(4)", [](const Image & src, Image & work) { work = src.Subsample(4); } },
+        { "Zoom2X", [](const Image & src, Image & work) {
+            // Sobre el cuadrante superior izquierdo: el resultado tiene el tamaño de la original
+            int half = src.get_rows() / 2;
+            work = src.CropView(0, 0, half, half).Zoom2X();
+        } },
+        { "Crop", [](const Image & src, Image & work) {
+            int n = src.get_rows();
+            work = src.Crop(n / 4, n / 4, n / 2, n / 2);
+        } },
+        { "CropView", [](const Image & src, Image & work) {
+            int n = src.get_rows();
+            work = src.CropView(n / 4, n / 4, n / 2, n / 2);
+        } },
+        { "Erode(15x15)", [](const Image & src, Image & work) { work = src.Erode(15, 15); } },
+        { "TopHat(15x15)", [](const Image & src, Image & work) { work = src.TopHat(15, 15); } },
+        { "Otsu+Threshold", [](const Image & src, Image & work) { work = src.Threshold(src.OtsuThreshold()); } },
+        { "Sauvola(31)", [](const Image & src, Image & work) { work = src.AdaptiveThreshold(SAUVOLA, 31, 0.34); } },
+        { "Equalize", [](const Image & src, Image & work) { work = src; work.Equalize(); } },
+        { "CLAHE(8x8)", [](const Image & src, Image & work) { work = src; work.CLAHE(8, 8, 2.0); } },
+        { "Rotate(3)", [](const Image & src, Image & work) { work = src.Rotate(3); } },
+        { "Sobel(L2)", [](const Image & src, Image & work) { work = src.Gradient(SOBEL, GRADIENT_L2); } },
+        { "ShuffleRows", [](const Image & src, Image & work) { work = src; work.ShuffleRows(); } },
+        { "GatherRows", [&index](const Image & src, Image & work) { work = src.GatherRows(index.data()); } },
+        { "SavePGZ", [&tmp](const Image & src, Image &) { src.Save(tmp.c_str()); } },
+        { "DecodePGZ", [&pgz](const Image &, Image & work) { work.LoadFromMemory(pgz.data(), pgz.size()); } },
+    };
+
+    vector<Result> results;
+    if (!gnuplot)
+        cout << "operacion,lado,hilos,segundos,mpixeles_s,aceleracion,eficiencia,rss_max_kb" << endl;
+
+    for (int side = 64; side <= max_side; side *= 2) {
+        cerr << "Lado " << side << "..." << endl;
+        Image src = Synthetic(side);
+        index.resize(side);
+        for (int r = 0; r < side; ++r)
+            index[r] = (int)((long long)r * 9973 % side);
+        src.Save(tmp.c_str());
+        ReadFileBytes(tmp.c_str(), pgz);
+
+        const long long pixels = (long long)side * side;
+        const int iters = (int)max(1LL, MIN_PIXELS_PER_SAMPLE / pixels);
+
+        for (const Operation & op : ops) {
+            double t1 = 0;
+            for (int threads : thread_counts) {
+                SetNumThreads(threads);
+                Image work(src);
+                work.set_pixel(0, 0, 0);  // imagen de trabajo con píxeles propios
+                double t = Measure(op, src, work, iters);
+                if (threads == 1)
+                    t1 = t;
+
+                Result r = { op.name, side, threads, t, pixels / t / 1e6, t1 / t, t1 / t / threads, MaxRSS() };
+                results.push_back(r);
+                if (!gnuplot)
+                    cout << r.op << "," << r.side << "," << r.threads << "," << scientific << setprecision(4) << r.seconds
+                         << "," << fixed << setprecision(2) << r.mpixels << "," << setprecision(3) << r.speedup << ","
+                         << r.efficiency << "," << r.rss_kb << endl;
+            }
+        }
+    }
+    SetNumThreads(0);
+    unlink(tmp.c_str());
+
+    // Un bloque por operación, en el orden en que se midieron
+    if (gnuplot)
+        for (const Operation & op : ops) {
+            cout << "# " << op.name << "\n# lado hilos segundos mpixeles_s aceleracion eficiencia rss_max_kb\n";
+            for (const Result & r : results)
+                if (r.op == op.name)
+                    cout << r.side << " " << r.threads << " " << scientific << setprecision(4) << r.seconds << " "
+                         << fixed << setprecision(2) << r.mpixels << " " << setprecision(3) << r.speedup << " "
+                         << r.efficiency << " " << r.rss_kb << "\n";
+            cout << "\n\n";
+        }
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file Fichero imaged.cpp, servidor de operaciones sobre imagenes
+ *
+ * Ofrece por un socket Unix las operaciones de negativo, subimagen, zoom, icono y contraste
+ * (ver imageServer.h), para que las aplicaciones no tengan que lanzar un proceso ni pasar por
+ * ficheros en cada peticion. Termina con SIGINT o SIGTERM.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <csignal>
+
+#include <imageServer.h>
+#include <parallel.h>
+
+using namespace std;
+
+static ImageServer *server = 0;
+
+// Stop() solo escribe en un eventfd, asi que puede llamarse desde el manejador
+static void Terminate (int){
+    if (server)
+        server->Stop();
+}
+
+int main (int argc, char *argv[]){
+
+    // Comprobar validez de la llamada
+    int hilos = argc == 3 ? atoi(argv[2]) : GetNumThreads();
+    if ((argc != 2 && argc != 3) || hilos <= 0){
+        cerr << "Error: Numero incorrecto de parametros.\n";
+        cerr << "Uso: imaged <Socket> [hilos]\n";
+        exit (1);
+    }
+
+    // Las peticiones se reparten entre los hilos del servidor; cada una usa los nucleos que sobran
+    SetNumThreads(max(1, GetNumThreads() / hilos));
+
+    ImageServer s(argv[1], hilos);
+    if (!s.Start()){
+        cerr << "Error: No pudo crearse el socket " << argv[1] << "." << endl;
+        return 1;
+    }
+    server = &s;
+    signal(SIGINT, Terminate);
+    signal(SIGTERM, Terminate);
+
+    cout << "Escuchando en " << argv[1] << " con " << hilos << " hilos" << endl;
+    s.Run();
+    cout << "Peticiones atendidas: " << s.Served() << endl;
+    return 0;
+}
@@ -5,110 +5,189 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <vector>
 #include <image.h>
+#include <imageKernels.h>
+#include <instrument.h>
+#include <parallel.h>
 
 #include <cassert>
+#include <cstdint>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-// Genera una subimagen de la original
-Image Image::Crop(int nrow, int ncol, int height, int width) const {
-    // Ancho y alto de la imagen original
-    int orig_width = this->get_rows();
-    int orig_height= this->get_cols();
-
-    // Inicializamos la imagen recortada
-    Image croppedImage(width, height);
-
-    // Para cada pixel iniciando en $nrow y $ncol asignamos el respectivo valor de
-    // la imagen original
-    for (int i = nrow; (i-nrow) < width && i < orig_width; ++i) {
-        for (int j = ncol; (j-ncol) < height && j < orig_height; ++j) {
-            byte value = this->get_pixel(i, j);
-            croppedImage.set_pixel(i-nrow, j-ncol, value);
+namespace {
+
+/*
+ * Division con redondeo al valor mas proximo sin instruccion de division.
+ * round(s / a) = floor((2s + a) / 2a), y floor(x / d) = (x * m) >> shift con
+ * m = ceil(2^shift / d), shift = 31 + ceil(log2 d), exacto para todo x < 2^31.
+ * Para bloques tan grandes que 2s + a no cabe en 31 bits se divide sin mas.
+ */
+struct RoundedDivider {
+    unsigned long long area, m;
+    int shift;
+    bool fast;
+
+    explicit RoundedDivider(unsigned long long a)
+        : area(a), m(0), shift(0), fast(a > 0 && 511 * a < (1ull << 31)) {
+        if (fast) {
+            unsigned long long d = 2 * a;
+            int l = 0;
+            while ((1ull << l) < d)
+                ++l;
+            shift = 31 + l;
+            m = ((1ull << shift) + d - 1) / d;
         }
     }
 
+    byte operator()(unsigned long long sum) const {
+        unsigned long long x = 2 * sum + area;
+        return (byte)(fast ? (x * m) >> shift : x / (2 * area));
+    }
+};
+
+// A partir de este tamaño el destino de GatherInto se escribe sin pasar por la caché. Con destinos
+// recién reservados las escrituras no temporales no ganan hasta tamaños muy superiores a la caché
+// (medido con el test 4 de barajar), así que el umbral es alto.
+const size_t STREAM_THRESHOLD = (size_t)128 << 20;
+
+// Filas por delante de la actual cuyo comienzo se pide a memoria, y bytes pedidos de cada una
+const int PREFETCH_DISTANCE = 4;
+const int PREFETCH_BYTES = 256;
+
+// Copia una fila con escrituras no temporales, que no desalojan de la caché los datos de origen
+void CopyRowStream(byte * dst, const byte * src, int n) {
+#ifdef __SSE2__
+    int k = 0;
+    for (; k < n && ((uintptr_t)(dst + k) & 15) != 0; ++k)
+        dst[k] = src[k];
+    for (; k + 16 <= n; k += 16)
+        _mm_stream_si128((__m128i *)(dst + k), _mm_loadu_si128((const __m128i *)(src + k)));
+    for (; k < n; ++k)
+        dst[k] = src[k];
+#else
+    memcpy(dst, src, n);
+#endif
+}
+
+}
+
+
+// Genera una subimagen de la original
+Image Image::Crop(int nrow, int ncol, int height, int width) const {
+    IMAGE_PROFILE_SCOPE("Crop");
+    IMAGE_PROFILE_PIXELS(height * width);
+    if (height <= 0 || width <= 0)
+        return Image();
+    // Inicializamos la imagen recortada: height filas de width columnas
+    Image croppedImage(height, width);
+
+    // Copiamos fila a fila la parte del recorte que cae dentro de la imagen original; con nrow o
+    // ncol negativos las primeras filas o columnas del recorte quedan fuera
+    int i0 = std::max(0, -nrow), j0 = std::max(0, -ncol);
+    int i1 = std::min(height, rows - nrow), j1 = std::min(width, cols - ncol);
+    for (int i = i0; i < i1 && j0 < j1; ++i)
+        memcpy(croppedImage.get_row(i) + j0, this->get_row(nrow + i) + ncol + j0, j1 - j0);
+
     // Retorna una nueva subimagen de la original
     return croppedImage;
 }
 
-Image Image::Zoom2X() const {
-    int n = (2 * this->get_rows()) - 1;
-    Image zoomedImage(n,n);
-
-    // Copiamos valores de la original e interpolamos por las columnas
-    for (int i = 0, i_orig = 0; i < n; i+=2, ++i_orig) {
+Image Image::CropView(int nrow, int ncol, int height, int width) const {
+    // Si el recorte no cae entero dentro de la imagen no hay pixeles que compartir para todo el
+    if (nrow < 0 || ncol < 0 || height <= 0 || width <= 0 || nrow + height > rows || ncol + width > cols)
+        return Crop(nrow, ncol, height, width);
 
-        byte value = this->get_pixel(i_orig, 0);
-        zoomedImage.set_pixel(i, 0, value);
+    IMAGE_PROFILE_SCOPE("CropView");
+    Image view;
+    view.rows = height;
+    view.cols = width;
+    view.table = new RowTable(height);
+    view.img = view.table->rows;
+    IMAGE_PROFILE_ALLOC(height * sizeof(byte *));
+    for (int i = 0; i < height; ++i)
+        view.img[i] = img[nrow + i] + ncol;
 
-        for (int j = 2, j_orig = 1; j < n; j+=2, ++j_orig) {
-            // Copiamos el valor
-            value = this->get_pixel(i_orig, j_orig);
-            zoomedImage.set_pixel(i, j, value);
+    // La vista es una referencia mas al bloque de la original
+    buffer->refs.fetch_add(1, std::memory_order_relaxed);
+    view.buffer = buffer;
+    return view;
+}
 
-            // Interpolamos por las filas
-            byte left = this->get_pixel(i_orig, j_orig - 1);
-            byte right = this->get_pixel(i_orig, j_orig);
-            byte interpol = (byte)round(((double)left + (double)right) / 2.0);
+Image Image::Zoom2X() const {
+    Image zoomedImage;
+    Zoom2X(zoomedImage);
+    return zoomedImage;
+}
 
-            zoomedImage.set_pixel(i, j - 1, interpol);
-        }
-    }
-    // Interpolamos por las filas
-    for (int i = 1; i < n; i+=2) {
-        for(int j = 0; j < n; ++j) {
-            double up;
-            double down;
-
-            // Filas pares
-            if (j % 2 == 0) {
-                up = (double)zoomedImage.get_pixel(i-1, j);
-                down = (double)zoomedImage.get_pixel(i+1, j);
-            } else {
-                // Filas impares, calculamos la interpolacion de los valores de 'arriba' y 'abajo'
-                // para evitar perdidas de precision
-                up = ((double)zoomedImage.get_pixel(i-1, j-1) + (double)zoomedImage.get_pixel(i-1, j+1)) / 2.0;
-                down = ((double)zoomedImage.get_pixel(i+1, j-1) + (double)zoomedImage.get_pixel(i+1, j+1)) / 2.0;
-            }
-            byte value = (byte)round((up + down) / 2.0);
-            zoomedImage.set_pixel(i, j, value);
-        }
+void Image::Zoom2X(Image & zoomedImage) const {
+    IMAGE_PROFILE_SCOPE("Zoom2X");
+    if (Empty()){
+        zoomedImage = Image();
+        return;
     }
+    int n = (2 * this->get_rows()) - 1;
+    IMAGE_PROFILE_PIXELS(n * n);
+    if (zoomedImage.rows != n || zoomedImage.cols != n)
+        zoomedImage = Image(n,n);
 
-    // Retornamos imagen con zoom x2
-    return zoomedImage;
+    const KernelTable & k = Kernels();
+
+    // Copiamos valores de la original en las filas pares e interpolamos por las columnas
+    for (int i = 0, i_orig = 0; i < n; i+=2, ++i_orig)
+        k.zoom_row(this->get_row(i_orig), zoomedImage.get_row(i), this->get_cols());
+
+    // Interpolamos por las filas, con las filas pares ya calculadas
+    for (int i = 1; i < n; i+=2)
+        k.zoom_mid(zoomedImage.get_row(i - 1), zoomedImage.get_row(i + 1), zoomedImage.get_row(i), n);
+}
+
+void Image::Invert() {
+    IMAGE_PROFILE_SCOPE("Invert");
+    IMAGE_PROFILE_PIXELS(size());
+    Detach();
+    const KernelTable & k = Kernels();
+    for (int i = 0; i < rows; ++i)
+        k.invert(img[i], img[i], cols);
 }
 
 void Image::AdjustContrast(byte in1, byte in2, byte out1, byte out2) {
+    IMAGE_PROFILE_SCOPE("AdjustContrast");
+    IMAGE_PROFILE_PIXELS(size());
 
     // Calculamos las pendientes de las rectas de la funcion a trozos
     const auto slope1 = (double)(((double)out1 - 0) / ((double)in1 - 0));
     const auto slope2 = (double)(((double)out2 - (double)out1) / ((double)in2 - (double)in1));
     const auto slope3 = (double)((255 - (double)out2) / (255 - (double)in2));
 
-    byte value = 0;
-    byte z = 0;
-
-    for (int k = 0; k < rows*cols; ++k) {
-        z = this->get_pixel(k);
+    // La funcion solo depende del valor del pixel: la tabulamos para los 256 valores posibles
+    byte lut[256];
+    for (int z = 0; z < 256; ++z) {
         if (z < in1) {
             // El valor esta por debajo del intervalo
-            value = (byte)round(0 + (slope1 * ((double)z - 0)));
-            this->set_pixel(k, value);
+            lut[z] = (byte)round(0 + (slope1 * ((double)z - 0)));
         } else if (z > in2) {
             // El valor esta por encima del intervalo
-            value = (byte)round((double)out2 + (slope3 * ((double)z - (double)in2)));
-            this->set_pixel(k, value);
+            lut[z] = (byte)round((double)out2 + (slope3 * ((double)z - (double)in2)));
         } else {
             // El valor esta dentro del intervalo
-            value = (byte)round((double)out1 + (slope2 * ((double)z - (double)in1)));
-            this->set_pixel(k, value);
+            lut[z] = (byte)round((double)out1 + (slope2 * ((double)z - (double)in1)));
         }
     }
+
+    Detach();
+    const KernelTable & k = Kernels();
+    for (int i = 0; i < rows; ++i)
+        k.lut(img[i], img[i], cols, lut);
 }
 
 void Image::ShuffleRows() {
+    IMAGE_PROFILE_SCOPE("ShuffleRows");
     // Implementacion 1 proporsionada por el profesorado
 /*
     const int p =  9973  ;
@@ -125,11 +204,15 @@ void Image::ShuffleRows() {
      * TODO: Change ADT internal representation to put this on work
      */
     // Implementacion 2
+    if (Empty())
+        return;
     const int p = 9973;
     int newr;
 
-    // Creamos un nuevo puntero a punteros
-    byte ** n_img = new byte * [rows];
+    // Creamos una nueva tabla de filas; los pixeles no se tocan y pueden seguir compartidos
+    RowTable * n_table = new RowTable(rows);
+    byte ** n_img = n_table->rows;
+    IMAGE_PROFILE_ALLOC(rows * sizeof(byte *));
 
     // Asignamos las filas barajadas de img a n_img
     for (int r = 0; r < this->rows; ++r) {
@@ -138,36 +221,148 @@ void Image::ShuffleRows() {
     }
 
     // Le asignamos a img la nueva imagen con filas barajadas
+    Release(this->table);
+    this->table = n_table;
     this->img = n_img;
     n_img = nullptr;
 }
 
-Image Image::Subsample(int factor) const {
-    int n_rows = floor(rows * 1.0 / factor * 1.0), n_cols = floor(cols * 1.0 / factor * 1.0);
+void Image::GatherInto(byte * dst, const byte * const * src, int nrows, int ncols) {
+    const bool stream = (size_t)nrows * ncols >= STREAM_THRESHOLD;
+    const int grain = std::max(1, (1 << 16) / std::max(ncols, 1));
+
+    ParallelFor(nrows, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            // Las filas de origen no siguen un orden que adivine el hardware: pedimos su comienzo antes
+            if (i + PREFETCH_DISTANCE < end) {
+                const byte * next = src[i + PREFETCH_DISTANCE];
+                for (int c = 0; c < ncols && c < PREFETCH_BYTES; c += 64)
+                    __builtin_prefetch(next + c, 0, 0);
+            }
+            byte * out = dst + (size_t)i * ncols;
+            if (stream)
+                CopyRowStream(out, src[i], ncols);
+            else
+                memcpy(out, src[i], ncols);
+        }
+#ifdef __SSE2__
+        // Las escrituras no temporales deben ser visibles antes de terminar la banda
+        if (stream)
+            _mm_sfence();
+#endif
+    }, grain);
+}
+
+Image Image::GatherRows(const int * index) const {
+    IMAGE_PROFILE_SCOPE("GatherRows");
+    IMAGE_PROFILE_PIXELS(size());
+    // El resultado se escribe entero: reservamos sin inicializar
+    Image gathered;
+    gathered.Initialize(rows, cols);
+    if (gathered.Empty())
+        return gathered;
+
+    std::vector<const byte *> src(rows);
+    for (int i = 0; i < rows; ++i)
+        src[i] = img[index[i]];
+    GatherInto(gathered.img[0], src.data(), rows, cols);
+
+    return gathered;
+}
+
+Image Image::Subsample(int factor, bool partial) const {
+    IMAGE_PROFILE_SCOPE("Subsample");
+    IMAGE_PROFILE_PIXELS(size());
+    // Con bloques parciales, un factor mayor que la imagen da el mismo icono de 1x1 que su lado mayor
+    if (partial)
+        factor = std::min(factor, std::max(rows, cols));
+    // Bloques completos y, si se piden, los bloques parciales del borde derecho e inferior
+    int full_rows = rows / factor, full_cols = cols / factor;
+    int rem_rows = partial ? rows % factor : 0, rem_cols = partial ? cols % factor : 0;
+    int n_rows = full_rows + (rem_rows > 0), n_cols = full_cols + (rem_cols > 0);
     Image icon(n_rows, n_cols);
-    byte value;
-
-    for (int i = 0, i_icon = 0; i_icon < n_rows; i+=factor, ++i_icon) {
-        for (int j = 0, j_icon = 0; j_icon < n_cols; j+=factor, ++j_icon) {
-            // Tomamos submatrices de orden factor x factor y calculamos la media de todos sus elementos
-            value = (byte)round(this->Mean(i, j, factor, factor));
-            // Asignamos el valor de la media redondeada al valor mas proximo a la imagen icono
-            icon.set_pixel(i_icon, j_icon, value);
+    if (icon.Empty())
+        return icon;
+
+    const KernelTable & k = Kernels();
+    // Un divisor por cada tamaño de bloque posible
+    const unsigned long long f = factor;
+    const RoundedDivider div_full(f * f), div_right(f * rem_cols);
+    const RoundedDivider div_bottom(rem_rows * f), div_corner((unsigned long long)rem_rows * rem_cols);
+    // Filas que caben en el acumulador de 32 bits; solo factores enormes necesitan volcarlo a 64 bits,
+    // y si ni una fila de un bloque cabe (factor > 2^32 / 255) se suma directamente en 64 bits
+    const bool narrow = 255ull * f <= 0xFFFFFFFFull;
+    const int chunk = narrow ? (int)std::min(0xFFFFFFFFull / (255ull * f), f) : 1;
+    const int grain = (int)std::max(1ll, (1ll << 16) / ((long long)factor * cols));
+
+    ParallelFor(n_rows, [&](int begin, int end) {
+        std::vector<unsigned> sums(n_cols);
+        std::vector<unsigned long long> wide(chunk < factor ? n_cols : 0);
+
+        for (int i_icon = begin; i_icon < end; ++i_icon) {
+            // Sumamos los bloques de esta fila del icono, fila a fila de la original
+            int height = i_icon < full_rows ? factor : rem_rows;
+            std::fill(sums.begin(), sums.end(), 0u);
+            std::fill(wide.begin(), wide.end(), 0ull);
+            for (int t = 0; t < height; ++t) {
+                const byte * in = this->get_row(i_icon * factor + t);
+                if (!narrow) {
+                    for (int c = 0; c < cols; ++c)
+                        wide[c / factor] += in[c];
+                    continue;
+                }
+                k.block_sum(in, sums.data(), full_cols, factor);
+                if (rem_cols > 0) {
+                    unsigned s = 0;
+                    for (int c = full_cols * factor; c < cols; ++c)
+                        s += in[c];
+                    sums[full_cols] += s;
+                }
+                if (!wide.empty() && (t + 1) % chunk == 0)
+                    for (int j = 0; j < n_cols; ++j) {
+                        wide[j] += sums[j];
+                        sums[j] = 0;
+                    }
+            }
+
+            // La media redondeada al valor mas proximo de cada bloque
+            const RoundedDivider & div = i_icon < full_rows ? div_full : div_bottom;
+            const RoundedDivider & div_last = i_icon < full_rows ? div_right : div_corner;
+            byte * out = icon.get_row(i_icon);
+            for (int j = 0; j < full_cols; ++j)
+                out[j] = div(wide.empty() ? sums[j] : wide[j] + sums[j]);
+            if (rem_cols > 0)
+                out[full_cols] = div_last(wide.empty() ? sums[full_cols] : wide[full_cols] + sums[full_cols]);
         }
-    }
+    }, grain);
 
     // Retornamos la imagen icono
     return icon;
 }
 
 double Image::Mean(int row, int col, int height, int width) const {
-    double sum = 0;
+    // La suma entera es exacta y coincide con acumular en double
+    long long sum = 0;
 
     for(int i = row; i-row < height; ++i) {
-        for(int j = col; j-col < width; ++j) {
-            sum += (double)this->get_pixel(i, j);
+        const byte * in = this->get_row(i) + col;
+        for(int j = 0; j < width; ++j) {
+            sum += in[j];
         }
     }
 
-    return sum / (height * width * 1.0);
+    return (double)sum / (height * width * 1.0);
+}
+
+void Image::PaintIn(const Image & in, int i, int j) {
+    IMAGE_PROFILE_SCOPE("PaintIn");
+    IMAGE_PROFILE_PIXELS(in.size());
+    // Recortamos la region a pintar a los limites de la imagen destino
+    int first_row = i < 0 ? -i : 0, first_col = j < 0 ? -j : 0;
+    int last_row = in.rows, last_col = in.cols;
+    if (i + last_row > rows) last_row = rows - i;
+    if (j + last_col > cols) last_col = cols - j;
+
+    for (int r = first_row; r < last_row && first_col < last_col; ++r)
+        memcpy(this->get_row(i + r) + j + first_col, in.get_row(r) + first_col, last_col - first_col);
 }
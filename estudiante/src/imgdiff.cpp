@@ -0,0 +1,67 @@
+/**
+ * @file Fichero imgdiff.cpp, compara dos imagenes PGM o PGZ
+ *
+ * Pensado para comprobar los resultados de los programas contra las imagenes de referencia de
+ * expected_img: como diff y cmp, termina con 0 si las imagenes son iguales, 1 si son distintas
+ * y 2 si hay algun error.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+
+#include <image.h>
+#include <imageCompare.h>
+#include <imageLoader.h>
+
+using namespace std;
+
+int main (int argc, char *argv[]){
+
+    // Comprobar validez de la llamada
+    const char *modo = argc == 4 ? argv[3] : "medidas";
+    bool solo_igualdad = strcmp(modo, "igual") == 0, con_ssim = strcmp(modo, "ssim") == 0;
+    if ((argc != 3 && argc != 4) || (!solo_igualdad && !con_ssim && strcmp(modo, "medidas") != 0)){
+        cerr << "Error: Numero incorrecto de parametros.\n";
+        cerr << "Uso: imgdiff <FichImagenA> <FichImagenB> [igual|medidas|ssim]\n";
+        exit (2);
+    }
+
+    // Leemos las dos imagenes a la vez
+    vector<string> paths = { argv[1], argv[2] };
+    ImageLoader loader(paths, 2, 2);
+    LoadedImage a, b;
+    loader.Next(a);
+    loader.Next(b);
+    for (const LoadedImage *item : { &a, &b })
+        if (!item->ok){
+            cerr << "Error: No pudo leerse la imagen " << item->path << "." << endl;
+            return 2;
+        }
+
+    if (a.image.get_rows() != b.image.get_rows() || a.image.get_cols() != b.image.get_cols()){
+        cout << "Dimensiones distintas: " << a.image.get_rows() << "x" << a.image.get_cols() << " y "
+             << b.image.get_rows() << "x" << b.image.get_cols() << endl;
+        return 1;
+    }
+
+    // Solo igualdad: la comparacion se detiene en la primera fila distinta
+    if (solo_igualdad){
+        bool iguales = ImagesEqual(a.image, b.image);
+        cout << (iguales ? "Iguales" : "Distintas") << endl;
+        return iguales ? 0 : 1;
+    }
+
+    ImageDiff d = CompareImages(a.image, b.image);
+    cout << "Pixeles distintos: " << d.differing << " de " << a.image.size() << endl;
+    cout << "Diferencia maxima: " << d.max_diff << endl;
+    cout << "MSE: " << fixed << setprecision(4) << d.mse << endl;
+    cout << "PSNR: " << d.psnr << " dB" << endl;
+    if (con_ssim)
+        cout << "SSIM: " << setprecision(6) << ImageSSIM(a.image, b.image) << endl;
+
+    return d.differing == 0 ? 0 : 1;
+}
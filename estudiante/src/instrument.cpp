@@ -0,0 +1,224 @@
+/**
+ * @file instrument.cpp
+ * @brief Fichero con definiciones para la instrumentación de las operaciones de la biblioteca
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <map>
+
+#include <instrument.h>
+
+using namespace std;
+
+namespace {
+
+// Límite de eventos de traza por hilo; los siguientes solo se cuentan como descartados
+const size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+struct TraceEvent {
+    int op;
+    uint64_t start, duration;
+    uint64_t pixels, alloc_bytes, io_bytes;
+};
+
+// Datos de un hilo. Solo los modifica su hilo; el cerrojo protege los volcados concurrentes.
+struct ThreadData {
+    mutex m;
+    int tid;
+    vector<ProfileStats> stats; // indexado por operación
+    vector<TraceEvent> events;
+    uint64_t dropped;
+};
+
+struct Registry {
+    mutex m;
+    vector<const char *> names;
+    vector<shared_ptr<ThreadData> > threads; // sobreviven a sus hilos hasta el volcado
+    int next_tid;
+    chrono::steady_clock::time_point epoch;
+
+    Registry() : next_tid(1), epoch(chrono::steady_clock::now()) {}
+};
+
+Registry & GetRegistry(){
+    static Registry registry;
+    return registry;
+}
+
+thread_local ThreadData *local_data = 0;
+thread_local ProfileScope *current_scope = 0;
+
+ThreadData & Local(){
+    if (!local_data){
+        shared_ptr<ThreadData> d = make_shared<ThreadData>();
+        d->dropped = 0;
+        Registry & r = GetRegistry();
+        lock_guard<mutex> lk(r.m);
+        d->tid = r.next_tid++;
+        r.threads.push_back(d);
+        local_data = d.get();
+    }
+    return *local_data;
+}
+
+uint64_t Now(){
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - GetRegistry().epoch).count();
+}
+
+// Vuelca los ficheros pedidos por variables de entorno al terminar el programa
+struct DumpAtExit {
+    DumpAtExit(){
+        GetRegistry(); // El registro debe destruirse después que este objeto
+    }
+    ~DumpAtExit(){
+        const char *json = getenv("IMAGE_PROFILE_JSON");
+        const char *trace = getenv("IMAGE_PROFILE_TRACE");
+        if (json && *json)
+            ProfileDumpJSON(json);
+        if (trace && *trace)
+            ProfileDumpTrace(trace);
+    }
+} dump_at_exit;
+
+}
+
+// _____________________________________________________________________________
+
+int ProfileRegister (const char *name){
+    Registry & r = GetRegistry();
+    lock_guard<mutex> lk(r.m);
+    r.names.push_back(name);
+    return (int)r.names.size() - 1;
+}
+
+ProfileScope::ProfileScope (int op)
+    : op(op), start(Now()), pixels(0), alloc_bytes(0), io_bytes(0), parent(current_scope) {
+    current_scope = this;
+}
+
+ProfileScope::~ProfileScope (){
+    uint64_t duration = Now() - start;
+    current_scope = parent;
+
+    ThreadData & d = Local();
+    lock_guard<mutex> lk(d.m);
+    if ((int)d.stats.size() <= op)
+        d.stats.resize(op + 1, ProfileStats());
+    ProfileStats & s = d.stats[op];
+    s.calls++;
+    s.nanos += duration;
+    s.pixels += pixels;
+    s.alloc_bytes += alloc_bytes;
+    s.io_bytes += io_bytes;
+
+    if (d.events.size() < MAX_EVENTS_PER_THREAD){
+        TraceEvent e = { op, start, duration, pixels, alloc_bytes, io_bytes };
+        d.events.push_back(e);
+    }
+    else
+        d.dropped++;
+}
+
+void ProfileAddAllocated (size_t bytes){
+    if (current_scope)
+        current_scope->AddAllocated(bytes);
+}
+
+void ProfileAddIO (size_t bytes){
+    if (current_scope)
+        current_scope->AddIO(bytes);
+}
+
+// _____________________________________________________________________________
+
+vector<ProfileStats> ProfileSnapshot (){
+    Registry & r = GetRegistry();
+    lock_guard<mutex> lk(r.m);
+
+    // Operaciones con el mismo nombre (varios puntos de llamada) se suman juntas
+    map<string, ProfileStats> merged;
+    for (const shared_ptr<ThreadData> & d : r.threads){
+        lock_guard<mutex> dlk(d->m);
+        for (size_t op = 0; op < d->stats.size(); ++op){
+            const ProfileStats & s = d->stats[op];
+            if (s.calls == 0)
+                continue;
+            ProfileStats & m = merged[r.names[op]];
+            m.name = r.names[op];
+            m.calls += s.calls;
+            m.nanos += s.nanos;
+            m.pixels += s.pixels;
+            m.alloc_bytes += s.alloc_bytes;
+            m.io_bytes += s.io_bytes;
+        }
+    }
+
+    vector<ProfileStats> res;
+    for (auto & kv : merged)
+        res.push_back(kv.second);
+    return res;
+}
+
+void ProfileReset (){
+    Registry & r = GetRegistry();
+    lock_guard<mutex> lk(r.m);
+    for (const shared_ptr<ThreadData> & d : r.threads){
+        lock_guard<mutex> dlk(d->m);
+        d->stats.clear();
+        d->events.clear();
+        d->dropped = 0;
+    }
+}
+
+// _____________________________________________________________________________
+
+bool ProfileDumpJSON (const char *path){
+    vector<ProfileStats> stats = ProfileSnapshot();
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return false;
+
+    fprintf(f, "{\n  \"operations\": [");
+    for (size_t k = 0; k < stats.size(); ++k){
+        const ProfileStats & s = stats[k];
+        fprintf(f, "%s\n    {\"name\": \"%s\", \"calls\": %llu, \"wall_ns\": %llu, \"pixels\": %llu, "
+                   "\"alloc_bytes\": %llu, \"io_bytes\": %llu}",
+                k ? "," : "", s.name, (unsigned long long)s.calls, (unsigned long long)s.nanos,
+                (unsigned long long)s.pixels, (unsigned long long)s.alloc_bytes,
+                (unsigned long long)s.io_bytes);
+    }
+    fprintf(f, "\n  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+bool ProfileDumpTrace (const char *path){
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return false;
+
+    Registry & r = GetRegistry();
+    lock_guard<mutex> lk(r.m);
+    bool first = true;
+    uint64_t dropped = 0;
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (const shared_ptr<ThreadData> & d : r.threads){
+        lock_guard<mutex> dlk(d->m);
+        dropped += d->dropped;
+        for (const TraceEvent & e : d->events){
+            fprintf(f, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, "
+                       "\"args\": {\"pixels\": %llu, \"alloc_bytes\": %llu, \"io_bytes\": %llu}}",
+                    first ? "" : ",", r.names[e.op], d->tid, e.start / 1000.0, e.duration / 1000.0,
+                    (unsigned long long)e.pixels, (unsigned long long)e.alloc_bytes,
+                    (unsigned long long)e.io_bytes);
+            first = false;
+        }
+    }
+    fprintf(f, "\n], \"otherData\": {\"dropped_events\": %llu}}\n", (unsigned long long)dropped);
+    return fclose(f) == 0;
+}
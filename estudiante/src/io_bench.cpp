@@ -0,0 +1,120 @@
+/**
+ * @file Fichero io_bench.cpp, mide la E/S de muchos ficheros PGM pequeños
+ *
+ * Escribe y lee miles de iconos con WritePGMImage / ReadPGMImage y compara la lectura con
+ * un lector basado en ifstream equivalente al que usaba la biblioteca anteriormente.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cctype>
+
+#include <imageIO.h>
+
+using namespace std;
+
+// Lector de referencia con iostreams: get/putback/getline y operator>>
+unsigned char *ReadPGMIostream(const char *path, int &rows, int &cols) {
+    ifstream f(path);
+    int maxval;
+    string linea;
+    rows = cols = 0;
+    if (f.get() != 'P' || f.get() != '5')
+        return 0;
+    char c;
+    do {
+        do { c = f.get(); } while (isspace(c));
+        f.putback(c);
+        if (c == '#') getline(f, linea);
+    } while (c == '#');
+    f >> cols >> rows >> maxval;
+    if (!f || rows <= 0 || cols <= 0)
+        return 0;
+    f.get();
+    unsigned char *res = new unsigned char[rows * cols];
+    f.read(reinterpret_cast<char *>(res), rows * cols);
+    if (!f) {
+        delete[] res;
+        return 0;
+    }
+    return res;
+}
+
+template <class F>
+double TimeMicros(F f) {
+    auto tini = chrono::steady_clock::now();
+    f();
+    auto tfin = chrono::steady_clock::now();
+    return chrono::duration<double, micro>(tfin - tini).count();
+}
+
+int main (int argc, char *argv[]){
+
+    // Comprobar validez de la llamada
+    if (argc < 2 || argc > 4){
+        cerr << "Error: Numero incorrecto de parametros.\n";
+        cerr << "Uso: io_bench <DirectorioTemporal> [n_ficheros] [lado]\n";
+        exit (1);
+    }
+
+    string dir = argv[1];
+    int nfiles = argc > 2 ? atoi(argv[2]) : 5000;
+    int side = argc > 3 ? atoi(argv[3]) : 32;
+    if (nfiles <= 0 || side <= 0){
+        cerr << "Error: El numero de ficheros y el lado deben ser positivos." << endl;
+        return 1;
+    }
+
+    vector<string> paths(nfiles);
+    for (int k = 0; k < nfiles; ++k)
+        paths[k] = dir + "/io_bench_" + to_string(k) + ".pgm";
+
+    vector<unsigned char> pixels((size_t)side * side);
+    for (size_t k = 0; k < pixels.size(); ++k)
+        pixels[k] = (unsigned char)(k * 7);
+
+    bool ok = true;
+    double t_write = TimeMicros([&]() {
+        for (int k = 0; k < nfiles; ++k)
+            ok = WritePGMImage(paths[k].c_str(), pixels.data(), side, side) && ok;
+    });
+    if (!ok){
+        cerr << "Error: No pudieron escribirse los ficheros en " << dir << endl;
+        return 1;
+    }
+
+    long checksum = 0;
+    auto read_all = [&](unsigned char *(*reader)(const char *, int &, int &)) {
+        for (int k = 0; k < nfiles; ++k) {
+            int rows, cols;
+            unsigned char *p = reader(paths[k].c_str(), rows, cols);
+            if (p)
+                checksum += p[rows * cols - 1];
+            else
+                ok = false;
+            delete[] p;
+        }
+    };
+
+    double t_read = TimeMicros([&]() { read_all(ReadPGMImage); });
+    double t_read_ios = TimeMicros([&]() { read_all(ReadPGMIostream); });
+
+    for (int k = 0; k < nfiles; ++k)
+        remove(paths[k].c_str());
+
+    if (!ok){
+        cerr << "Error: No pudieron leerse los ficheros." << endl;
+        return 1;
+    }
+
+    cout << nfiles << " ficheros de " << side << "x" << side << " (checksum " << checksum << ")\n";
+    cout << "WritePGMImage:        " << t_write / nfiles << " us/fichero\n";
+    cout << "ReadPGMImage:         " << t_read / nfiles << " us/fichero\n";
+    cout << "Lector con iostreams: " << t_read_ios / nfiles << " us/fichero\n";
+
+    return 0;
+}
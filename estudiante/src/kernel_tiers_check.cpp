@@ -0,0 +1,212 @@
+/**
+ * @file Fichero kernel_tiers_check.cpp, comprueba que todos los niveles de núcleos coinciden
+ *
+ * Ejecuta cada núcleo de la KernelTable de cada nivel disponible en la CPU sobre datos
+ * aleatorios, con longitudes que cubren los restos de los bucles vectoriales y punteros sin
+ * alinear, y compara el resultado byte a byte con el nivel baseline. Termina con 1 si algún
+ * núcleo difiere. Los niveles que la CPU no admite se indican y se saltan.
+ */
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cstring>
+#include <cstdint>
+
+#include <imageKernels.h>
+
+using namespace std;
+
+namespace {
+
+mt19937 rng(2024);
+
+// Longitudes probadas: pequeñas, alrededor de los anchos de vector (16, 32, 64) y grandes
+const int LENGTHS[] = { 1, 2, 3, 7, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 127, 128, 129, 255, 1000, 4099 };
+
+// Desplazamiento de los punteros respecto a la alineación del vector
+const int OFFSET = 3;
+
+vector<unsigned char> Bytes (int n){
+    vector<unsigned char> v(n + OFFSET + 2);
+    for (unsigned char & x : v)
+        x = (unsigned char)rng();
+    return v;
+}
+
+template <class T>
+vector<T> Values (int n, int lo, int hi){
+    uniform_int_distribution<int> d(lo, hi);
+    vector<T> v(n + OFFSET);
+    for (T & x : v)
+        x = (T)d(rng);
+    return v;
+}
+
+// Ejecuta el núcleo con la tabla base y con la del nivel sobre copias de las mismas salidas
+struct Checker {
+    const KernelTable & base;
+    const KernelTable & tier;
+    const char * tier_name;
+    int failures = 0;
+
+    template <class T>
+    void Compare (const char * kernel, int n, const vector<T> & expected, const vector<T> & got){
+        if (expected != got){
+            cerr << "Error: " << kernel << " difiere en " << tier_name << " con n = " << n << endl;
+            ++failures;
+        }
+    }
+};
+
+void CheckAll (Checker & c){
+    const KernelTable & b = c.base;
+    const KernelTable & t = c.tier;
+
+    for (int n : LENGTHS){
+        vector<unsigned char> src = Bytes(n), other = Bytes(n), up = Bytes(n), down = Bytes(n);
+        const unsigned char * s = &src[OFFSET];
+        const unsigned char * o = &other[OFFSET];
+        vector<unsigned char> e8(n + OFFSET + 2 * n), g8 = e8;
+
+        // invert, lut
+        b.invert(s, &e8[OFFSET], n);
+        t.invert(s, &g8[OFFSET], n);
+        c.Compare("invert", n, e8, g8);
+
+        vector<unsigned char> table = Bytes(256);
+        b.lut(s, &e8[OFFSET], n, table.data());
+        t.lut(s, &g8[OFFSET], n, table.data());
+        c.Compare("lut", n, e8, g8);
+
+        // zoom_row, zoom_mid
+        b.zoom_row(s, &e8[OFFSET], n);
+        t.zoom_row(s, &g8[OFFSET], n);
+        c.Compare("zoom_row", n, e8, g8);
+
+        b.zoom_mid(s, o, &e8[OFFSET], n);
+        t.zoom_mid(s, o, &g8[OFFSET], n);
+        c.Compare("zoom_mid", n, e8, g8);
+
+        // block_sum, con factores pequeños y grandes
+        for (int factor : { 1, 2, 3, 4, 8, 13 }){
+            int n_out = n / factor;
+            vector<unsigned> e32 = Values<unsigned>(n_out, 0, 1 << 20), g32 = e32;
+            b.block_sum(s, &e32[OFFSET], n_out, factor);
+            t.block_sum(s, &g32[OFFSET], n_out, factor);
+            c.Compare("block_sum", n, e32, g32);
+        }
+
+        // pixel_min, pixel_max, también escribiendo sobre una entrada
+        b.pixel_min(s, o, &e8[OFFSET], n);
+        t.pixel_min(s, o, &g8[OFFSET], n);
+        c.Compare("pixel_min", n, e8, g8);
+
+        b.pixel_max(s, o, &e8[OFFSET], n);
+        t.pixel_max(s, o, &g8[OFFSET], n);
+        c.Compare("pixel_max", n, e8, g8);
+
+        vector<unsigned char> ea = src, ga = src;
+        b.pixel_max(&ea[OFFSET], o, &ea[OFFSET], n);
+        t.pixel_max(&ga[OFFSET], o, &ga[OFFSET], n);
+        c.Compare("pixel_max (en su sitio)", n, ea, ga);
+
+        // threshold, pack_threshold, popcount
+        for (int th : { 0, 127, 254, 255 }){
+            b.threshold(s, &e8[OFFSET], n, (unsigned char)th);
+            t.threshold(s, &g8[OFFSET], n, (unsigned char)th);
+            c.Compare("threshold", n, e8, g8);
+
+            vector<uint64_t> e64((n + 63) / 64 + OFFSET, ~0ull), g64 = e64;
+            b.pack_threshold(s, &e64[OFFSET], n, (unsigned char)th);
+            t.pack_threshold(s, &g64[OFFSET], n, (unsigned char)th);
+            c.Compare("pack_threshold", n, e64, g64);
+        }
+
+        vector<uint64_t> words(n + OFFSET);
+        for (uint64_t & w : words)
+            w = ((uint64_t)rng() << 32) | rng();
+        if (b.popcount(&words[OFFSET], n) != t.popcount(&words[OFFSET], n)){
+            cerr << "Error: popcount difiere en " << c.tier_name << " con n = " << n << endl;
+            ++c.failures;
+        }
+
+        // diff
+        unsigned e_differ, g_differ;
+        unsigned char e_max, g_max;
+        unsigned e_sq = b.diff(s, o, n, &e_differ, &e_max);
+        unsigned g_sq = t.diff(s, o, n, &g_differ, &g_max);
+        if (e_sq != g_sq || e_differ != g_differ || e_max != g_max){
+            cerr << "Error: diff difiere en " << c.tier_name << " con n = " << n << endl;
+            ++c.failures;
+        }
+
+        // blend_q8, lerp_q8
+        vector<uint16_t> qa = Values<uint16_t>(n, 0, 255 * 256), qb = Values<uint16_t>(n, 0, 255 * 256);
+        vector<uint16_t> w = Values<uint16_t>(n, 0, 256);
+        w[OFFSET] = 0;
+        w[OFFSET + n - 1] = 256;
+        b.blend_q8(&qa[OFFSET], &qb[OFFSET], &w[OFFSET], &e8[OFFSET], n);
+        t.blend_q8(&qa[OFFSET], &qb[OFFSET], &w[OFFSET], &g8[OFFSET], n);
+        c.Compare("blend_q8", n, e8, g8);
+
+        vector<uint16_t> e16(n + OFFSET), g16 = e16;
+        b.lerp_q8(s, o, &w[OFFSET], &e16[OFFSET], n);
+        t.lerp_q8(s, o, &w[OFFSET], &g16[OFFSET], n);
+        c.Compare("lerp_q8", n, e16, g16);
+
+        // gradient, magnitude, laplacian: las filas se leen en [-1, n]
+        const unsigned char * u = &up[OFFSET + 1], * m = &src[OFFSET + 1], * d = &down[OFFSET + 1];
+        for (int op = 0; op < 2; ++op){
+            const int ka = op ? 3 : 1, kb = op ? 10 : 2;
+            vector<int16_t> egx(n + OFFSET), egy = egx, ggx = egx, ggy = egx;
+            b.gradient(u, m, d, ka, kb, &egx[OFFSET], &egy[OFFSET], n);
+            t.gradient(u, m, d, ka, kb, &ggx[OFFSET], &ggy[OFFSET], n);
+            c.Compare("gradient (gx)", n, egx, ggx);
+            c.Compare("gradient (gy)", n, egy, ggy);
+        }
+
+        vector<int16_t> gx = Values<int16_t>(n, -4080, 4080), gy = Values<int16_t>(n, -4080, 4080);
+        for (int l2 = 0; l2 < 2; ++l2){
+            b.magnitude(&gx[OFFSET], &gy[OFFSET], &e16[OFFSET], n, l2);
+            t.magnitude(&gx[OFFSET], &gy[OFFSET], &g16[OFFSET], n, l2);
+            c.Compare("magnitude", n, e16, g16);
+        }
+
+        vector<int16_t> elap(n + OFFSET), glap = elap;
+        b.laplacian(u, m, d, &elap[OFFSET], n);
+        t.laplacian(u, m, d, &glap[OFFSET], n);
+        c.Compare("laplacian", n, elap, glap);
+
+        // saturate_u8
+        vector<uint16_t> wide = Values<uint16_t>(n, 0, 65535);
+        b.saturate_u8(&wide[OFFSET], &e8[OFFSET], n);
+        t.saturate_u8(&wide[OFFSET], &g8[OFFSET], n);
+        c.Compare("saturate_u8", n, e8, g8);
+    }
+}
+
+}
+
+int main (){
+    const KernelTable * base = KernelsForTier(TIER_BASELINE);
+    if (!base){
+        cerr << "Error: No hay nucleos baseline." << endl;
+        return 1;
+    }
+
+    int failures = 0;
+    for (int tier = TIER_BASELINE + 1; tier < TIER_COUNT; ++tier){
+        const char * name = TierName((CpuTier)tier);
+        const KernelTable * table = KernelsForTier((CpuTier)tier);
+        if (!table){
+            cout << name << ": no disponible, se salta" << endl;
+            continue;
+        }
+        Checker c = { *base, *table, name };
+        CheckAll(c);
+        cout << name << ": " << (c.failures ? "DIFIERE" : "igual que baseline") << endl;
+        failures += c.failures;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,7 @@
+/**
+ * @file kernelsAVX2.cpp
+ * @brief Núcleos de cálculo compilados para AVX2
+ */
+
+#define KERNEL_TABLE kernels_avx2
+#include "kernelsImpl.inc"
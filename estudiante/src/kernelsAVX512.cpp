@@ -0,0 +1,7 @@
+/**
+ * @file kernelsAVX512.cpp
+ * @brief Núcleos de cálculo compilados para AVX-512 (F y BW)
+ */
+
+#define KERNEL_TABLE kernels_avx512
+#include "kernelsImpl.inc"
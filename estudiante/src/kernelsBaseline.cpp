@@ -0,0 +1,7 @@
+/**
+ * @file kernelsBaseline.cpp
+ * @brief Núcleos de cálculo compilados sin opciones específicas (SSE2 en x86-64)
+ */
+
+#define KERNEL_TABLE kernels_baseline
+#include "kernelsImpl.inc"
@@ -0,0 +1,7 @@
+/**
+ * @file kernelsSSE42.cpp
+ * @brief Núcleos de cálculo compilados para SSE4.2
+ */
+
+#define KERNEL_TABLE kernels_sse42
+#include "kernelsImpl.inc"
@@ -0,0 +1,128 @@
+/**
+ * @file Fichero mosaic.cpp, genera una hoja de contactos con los iconos de una lista de imagenes
+ *
+ * Las imagenes se leen de un fichero de texto (una ruta por linea). Cada imagen se reduce con
+ * Image::Subsample hasta caber en una celda y se pinta con Image::PaintIn sobre un lienzo reservado
+ * de antemano. Solo el lienzo y una imagen por hilo de trabajo permanecen en memoria a la vez.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include <image.h>
+#include <parallel.h>
+
+using namespace std;
+
+// Factor de reduccion minimo para que una imagen de nrows x ncols quepa en una celda de lado cell
+int FitFactor(int nrows, int ncols, int cell) {
+    int factor_rows = (nrows + cell - 1) / cell;
+    int factor_cols = (ncols + cell - 1) / cell;
+    int factor = factor_rows > factor_cols ? factor_rows : factor_cols;
+    return factor > 0 ? factor : 1;
+}
+
+int main (int argc, char *argv[]){
+
+    char *lista, *destino; // nombres de los ficheros
+
+    // Comprobar validez de la llamada
+    if (argc != 5 && argc != 6){
+        cerr << "Error: Numero incorrecto de parametros.\n";
+        cerr << "Uso: mosaic <FichListaImagenes> <FichImagenDestino> <lado_celda> <columnas> [hilos]\n";
+        exit (1);
+    }
+
+    // Obtener argumentos
+    lista   = argv[1];
+    destino = argv[2];
+    int cell = atoi(argv[3]), ncols = atoi(argv[4]);
+    int nthreads = argc == 6 ? atoi(argv[5]) : (int)thread::hardware_concurrency();
+    if (nthreads <= 0) nthreads = 1;
+
+    if (cell <= 0 || ncols <= 0){
+        cerr << "Error: El lado de celda y el numero de columnas deben ser positivos." << endl;
+        return 1;
+    }
+
+    // Leer la lista de rutas
+    ifstream f(lista);
+    if (!f){
+        cerr << "Error: No pudo leerse la lista de imagenes." << endl;
+        return 1;
+    }
+    vector<string> paths;
+    string linea;
+    while (getline(f, linea)){
+        if (!linea.empty() && linea[linea.size() - 1] == '\r') linea.erase(linea.size() - 1);
+        if (!linea.empty()) paths.push_back(linea);
+    }
+    if (paths.empty()){
+        cerr << "Error: La lista de imagenes esta vacia." << endl;
+        return 1;
+    }
+
+    // Mostramos argumentos
+    cout << endl;
+    cout << "Lista de imagenes: " << lista << " (" << paths.size() << " ficheros)" << endl;
+    cout << "Fichero resultado: " << destino << endl;
+
+    // Reservamos el lienzo completo de antemano
+    int nrows = (int)((paths.size() + ncols - 1) / ncols);
+    Image canvas(nrows * cell, ncols * cell);
+
+    // Cada hilo toma la siguiente imagen pendiente, la reduce y la pinta en su celda.
+    // Las celdas no se solapan, por lo que los hilos no necesitan sincronizarse al pintar.
+    atomic<size_t> next(0);
+    atomic<int> errors(0);
+    auto worker = [&]() {
+        Image image;
+        size_t k;
+        while ((k = next++) < paths.size()) {
+            if (!image.Load(paths[k].c_str())) {
+                cerr << "Aviso: No pudo leerse la imagen " << paths[k] << endl;
+                ++errors;
+                continue;
+            }
+            Image icon = image.Subsample(FitFactor(image.get_rows(), image.get_cols(), cell));
+
+            // Centramos el icono en su celda
+            int row = (int)(k / ncols) * cell + (cell - icon.get_rows()) / 2;
+            int col = (int)(k % ncols) * cell + (cell - icon.get_cols()) / 2;
+            canvas.PaintIn(icon, row, col);
+        }
+    };
+
+    // Cada hilo de trabajo reduce sus imagenes con los nucleos que sobran; con un hilo por nucleo,
+    // Subsample no lanza hilos propios
+    SetNumThreads(max(1, GetNumThreads() / nthreads));
+
+    vector<thread> workers;
+    for (int t = 1; t < nthreads; ++t)
+        workers.emplace_back(worker);
+    worker();
+    for (thread & t : workers)
+        t.join();
+
+    cout << endl;
+    cout << "Mosaico = " << canvas.get_rows() << " filas x " << canvas.get_cols() << " columnas, "
+         << errors << " imagenes no leidas" << endl;
+
+    // Guardar la imagen resultado en el fichero
+    if (canvas.Save(destino))
+        cout  << "La imagen se guardo en " << destino << endl;
+    else{
+        cerr << "Error: No pudo guardarse la imagen." << endl;
+        cerr << "Terminando la ejecucion del programa." << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -44,8 +44,7 @@ int main (int argc, char *argv[]){
   cout << "   Imagen   = " << image.get_rows()  << " filas x " << image.get_cols() << " columnas " << endl;
 
   // Calcular el negativo
-  for (int i=0; i<image.size(); i++)
-      image.set_pixel(i,255-image.get_pixel(i));
+  image.Invert();
 
   // Guardar la imagen resultado en el fichero
   if (image.Save(destino))
@@ -0,0 +1,38 @@
+/**
+ * @file parallel.cpp
+ * @brief Fichero con definiciones para la configuración de hilos de la biblioteca
+ */
+
+#include <atomic>
+#include <cstdlib>
+
+#include <parallel.h>
+
+using namespace std;
+
+namespace {
+
+atomic<int> num_threads(0);
+
+int DefaultThreads(){
+    const char *env = getenv("IMAGE_THREADS");
+    int n = env ? atoi(env) : 0;
+    if (n <= 0)
+        n = (int)thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+}
+
+int GetNumThreads(){
+    int n = num_threads.load(memory_order_relaxed);
+    if (n <= 0){
+        n = DefaultThreads();
+        num_threads.store(n, memory_order_relaxed);
+    }
+    return n;
+}
+
+void SetNumThreads(int nthreads){
+    num_threads.store(nthreads > 0 ? nthreads : DefaultThreads(), memory_order_relaxed);
+}
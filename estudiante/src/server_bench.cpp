@@ -0,0 +1,112 @@
+/**
+ * @file Fichero server_bench.cpp, generador de carga para el servidor imaged
+ *
+ * Lanza varios clientes, cada uno con su conexion, que piden al servidor operaciones sobre
+ * imagenes aleatorias de lado fijo, y mide el numero de peticiones por segundo y la latencia
+ * de cada una. Como referencia, mide tambien las mismas operaciones hechas en el propio proceso.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+#include <image.h>
+#include <imageServer.h>
+
+using namespace std;
+
+// Peticion numero k de la mezcla: las operaciones de los programas, por turno
+static bool Request (ImageClient & client, const Image & in, int k, Image & out){
+    const int side = in.get_rows();
+    switch (k % 4){
+        case 0:  return client.Invert(in, out);
+        case 1:  return client.Subsample(in, 4, out);
+        case 2:  return client.AdjustContrast(in, 40, 200, 0, 255, out);
+        default: return client.Zoom(in, side / 4, side / 4, side / 2, out);
+    }
+}
+
+static void Local (const Image & in, int k, Image & out){
+    const int side = in.get_rows();
+    switch (k % 4){
+        case 0:  out = in; out.Invert(); break;
+        case 1:  out = in.Subsample(4); break;
+        case 2:  out = in; out.AdjustContrast(40, 200, 0, 255); break;
+        default: out = in.CropView(side / 4, side / 4, side / 2, side / 2).Zoom2X(); break;
+    }
+}
+
+int main (int argc, char *argv[]){
+
+    // Comprobar validez de la llamada
+    int clientes = argc >= 3 ? atoi(argv[2]) : 4;
+    int peticiones = argc >= 4 ? atoi(argv[3]) : 2000;
+    int lado = argc >= 5 ? atoi(argv[4]) : 64;
+    if (argc < 2 || argc > 5 || clientes <= 0 || peticiones <= 0 || lado < 4){
+        cerr << "Error: Numero incorrecto de parametros.\n";
+        cerr << "Uso: server_bench <Socket> [clientes] [peticiones_por_cliente] [lado]\n";
+        exit (1);
+    }
+
+    Image in(lado, lado);
+    mt19937 rng(1);
+    for (int i = 0; i < lado; ++i)
+        for (int j = 0; j < lado; ++j)
+            in.set_pixel(i, j, (byte)(rng() & 255));
+
+    // Referencia: las mismas operaciones sin servidor
+    Image out;
+    auto t0 = chrono::steady_clock::now();
+    for (int k = 0; k < peticiones; ++k)
+        Local(in, k, out);
+    double local = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count() / peticiones;
+
+    vector<vector<double>> latencias(clientes);
+    vector<int> fallos(clientes, 0);
+    vector<thread> hilos;
+    t0 = chrono::steady_clock::now();
+    for (int c = 0; c < clientes; ++c)
+        hilos.emplace_back([&, c]() {
+            ImageClient client;
+            if (!client.Connect(argv[1])){
+                fallos[c] = peticiones;
+                return;
+            }
+            Image res;
+            for (int k = 0; k < peticiones; ++k){
+                auto ini = chrono::steady_clock::now();
+                if (!Request(client, in, k + c, res))
+                    ++fallos[c];
+                latencias[c].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - ini).count());
+            }
+        });
+    for (thread & h : hilos)
+        h.join();
+    double segundos = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    vector<double> todas;
+    int total_fallos = 0;
+    for (int c = 0; c < clientes; ++c){
+        todas.insert(todas.end(), latencias[c].begin(), latencias[c].end());
+        total_fallos += fallos[c];
+    }
+    if (todas.empty()){
+        cerr << "Error: No pudo conectarse con el servidor " << argv[1] << "." << endl;
+        return 1;
+    }
+    sort(todas.begin(), todas.end());
+    auto percentil = [&](double p) { return todas[min(todas.size() - 1, (size_t)(p * todas.size()))]; };
+
+    cout << clientes << " clientes x " << peticiones << " peticiones, imagenes de " << lado << "x" << lado << endl;
+    cout << fixed << setprecision(1);
+    cout << "Peticiones por segundo: " << todas.size() / segundos << endl;
+    cout << "Latencia (us): p50 " << percentil(0.5) << ", p99 " << percentil(0.99) << ", max " << todas.back() << endl;
+    cout << "En el propio proceso: " << local << " us/peticion" << endl;
+    cout << "Fallos: " << total_fallos << endl;
+    return total_fallos == 0 ? 0 : 1;
+}
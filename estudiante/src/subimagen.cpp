@@ -21,7 +21,7 @@ int main (int argc, char *argv[]){
     // Comprobar validez de la llamada
     if (argc != 7){
         cerr << "Error: Numero incorrecto de parametros.\n";
-        cerr << "Uso: subimagen <FichImagenOriginal> <FichImagenDestino> <fila> <columna> <ancho> <alto>\n";
+        cerr << "Uso: subimagen <FichImagenOriginal> <FichImagenDestino> <fila> <columna> <alto> <ancho>\n";
         exit (1);
     }
 
@@ -47,8 +47,8 @@ int main (int argc, char *argv[]){
     cout << "   Imagen   = " << image.get_rows()  << " filas x " << image.get_cols() << " columnas " << endl;
 
     // Recorta la imagen
-    int nrow = atoi(argv[3]), ncol = atoi(argv[4]), width = atoi(argv[5]), height = atoi(argv[6]);
-    Image croppedImage = image.Crop(nrow, ncol, height, width);
+    int nrow = atoi(argv[3]), ncol = atoi(argv[4]), height = atoi(argv[5]), width = atoi(argv[6]);
+    Image croppedImage = image.CropView(nrow, ncol, height, width);
 
     // Guardar la imagen resultado en el fichero
     if (croppedImage.Save(destino))
@@ -0,0 +1,498 @@
+/**
+ * @file tiledImage.cpp
+ * @brief Fichero con definiciones para la clase TiledImage
+ *
+ * Cada bloque ocupa TILE_SIZE x TILE_SIZE bytes en el fichero temporal, en el orden de las
+ * filas de bloques, también los de los bordes aunque solo usen una parte. El fichero se crea
+ * con su tamaño final y sin escribir nada: las zonas nunca escritas se leen como ceros.
+ *
+ * En memoria hay un número fijo de marcos, cada uno con sitio para un bloque. Un bloque en uso
+ * queda fijado a su marco hasta que se libera; para traer otro se expulsa el marco libre usado
+ * hace más tiempo, escribiéndolo antes si se modificó. Las lecturas y escrituras del fichero
+ * se hacen fuera del cerrojo de la caché, así que varios hilos pueden tener E/S en curso.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <tiledImage.h>
+#include <fileIO.h>
+#include <imageIO.h>
+#include <imageKernels.h>
+#include <instrument.h>
+#include <parallel.h>
+
+using namespace std;
+
+namespace {
+
+const size_t TILE_BYTES = (size_t)TiledImage::TILE_SIZE * TiledImage::TILE_SIZE;
+
+// Uso que se hará de un bloque al traerlo a memoria
+enum TileMode {
+    TILE_READ,      // solo lectura
+    TILE_UPDATE,    // lectura y escritura
+    TILE_OVERWRITE  // se escriben todos sus píxeles: no hace falta leerlo
+};
+
+bool ReadAt (int fd, unsigned char * buf, size_t n, off_t offset){
+    size_t done = 0;
+    while (done < n){
+        ssize_t r = pread(fd, buf + done, n - done, offset + done);
+        if (r > 0)
+            done += r;
+        else if (r == 0 || errno != EINTR)
+            return false;
+    }
+    return true;
+}
+
+bool WriteAt (int fd, const unsigned char * buf, size_t n, off_t offset){
+    size_t done = 0;
+    while (done < n){
+        ssize_t w = pwrite(fd, buf + done, n - done, offset + done);
+        if (w > 0)
+            done += w;
+        else if (w == 0 || errno != EINTR)
+            return false;
+    }
+    return true;
+}
+
+}
+
+// _____________________________________________________________________________
+
+struct TiledImage::Cache {
+
+    struct Frame {
+        int tile;    // -1 si está libre
+        int pins;    // usos en curso; no se expulsa mientras sea > 0
+        bool dirty;  // modificado desde que se leyó
+        bool busy;   // un hilo está escribiendo el bloque anterior o leyendo el nuevo
+    };
+
+    int fd;
+    bool good;
+    mutex m;
+    condition_variable released;              // se ha liberado un marco o ha terminado una E/S
+    unique_ptr<unsigned char[]> pool;
+    vector<Frame> frames;
+    vector<int> frame_of;                     // marco de cada bloque, -1 si no está en memoria
+    vector<char> flushing;                    // bloques expulsados cuya escritura no ha terminado
+    list<int> lru;                            // marcos, el usado más recientemente al principio
+    vector<list<int>::iterator> where;        // posición de cada marco en lru
+    uint64_t hits, misses, reads, writes;
+
+    Cache (int fd, int ntiles, size_t nframes)
+        : fd(fd), good(fd >= 0), pool(new unsigned char[nframes * TILE_BYTES]), frames(nframes),
+          frame_of(ntiles, -1), flushing(ntiles, 0), where(nframes), hits(0), misses(0), reads(0), writes(0) {
+        for (size_t f = 0; f < nframes; ++f){
+            frames[f] = { -1, 0, false, false };
+            where[f] = lru.insert(lru.end(), (int)f);
+        }
+    }
+
+    ~Cache (){
+        if (fd >= 0)
+            close(fd);
+    }
+
+    unsigned char * Data (int f){
+        return pool.get() + f * TILE_BYTES;
+    }
+
+    /*
+     * Fija el bloque a un marco, trayéndolo a memoria si no estaba. La lectura del bloque y la
+     * escritura del que se expulsa se hacen sin el cerrojo, con el marco marcado como ocupado:
+     * los demás hilos siguen usando los bloques que ya están en memoria y haciendo su propia E/S,
+     * y solo esperan los que piden este mismo bloque o el que se está escribiendo.
+     */
+    unsigned char * Acquire (int tile, int mode){
+        unique_lock<mutex> lock(m);
+        while (true){
+            int f = frame_of[tile];
+            if (f >= 0){
+                if (frames[f].busy){
+                    released.wait(lock);
+                    continue;
+                }
+                ++hits;
+                frames[f].pins++;
+                frames[f].dirty |= mode != TILE_READ;
+                lru.splice(lru.begin(), lru, where[f]);
+                return Data(f);
+            }
+
+            // Hasta que el bloque no esté escrito, leerlo del fichero daría su contenido anterior
+            if (flushing[tile]){
+                released.wait(lock);
+                continue;
+            }
+
+            // El marco libre usado hace más tiempo; si todos están fijados u ocupados, se espera
+            // a que algún hilo libere el suyo
+            auto victim = find_if(lru.rbegin(), lru.rend(), [&](int g) {
+                return frames[g].pins == 0 && !frames[g].busy;
+            });
+            if (victim == lru.rend()){
+                released.wait(lock);
+                continue;
+            }
+            f = *victim;
+            Frame & frame = frames[f];
+            const int old = frame.tile;
+            const bool flush = old >= 0 && frame.dirty;
+            const bool read = mode != TILE_OVERWRITE;
+            if (old >= 0){
+                frame_of[old] = -1;
+                flushing[old] = flush;
+            }
+            frame = { tile, 1, mode != TILE_READ, true };
+            frame_of[tile] = f;
+            lru.splice(lru.begin(), lru, where[f]);
+            ++misses;
+
+            lock.unlock();
+            bool ok = true;
+            if (flush)
+                ok = WriteAt(fd, Data(f), TILE_BYTES, (off_t)old * TILE_BYTES);
+            if (read && !ReadAt(fd, Data(f), TILE_BYTES, (off_t)tile * TILE_BYTES)){
+                memset(Data(f), 0, TILE_BYTES);
+                ok = false;
+            }
+            lock.lock();
+
+            good &= ok;
+            writes += flush;
+            reads += read;
+            if (flush)
+                flushing[old] = 0;
+            frame.busy = false;
+            lock.unlock();
+            released.notify_all();
+            return Data(f);
+        }
+    }
+
+    // Libera un bloque fijado. Si no volverá a usarse pronto pasa a ser el primero en expulsarse.
+    void Release (int tile, bool once){
+        {
+            lock_guard<mutex> lock(m);
+            int f = frame_of[tile];
+            if (--frames[f].pins == 0 && once)
+                lru.splice(lru.end(), lru, where[f]);
+        }
+        released.notify_all();
+    }
+
+    // Pide al sistema que vaya leyendo un bloque que se usará enseguida
+    void Prefetch (int tile){
+        lock_guard<mutex> lock(m);
+        if (frame_of[tile] < 0)
+            posix_fadvise(fd, (off_t)tile * TILE_BYTES, TILE_BYTES, POSIX_FADV_WILLNEED);
+    }
+};
+
+// _____________________________________________________________________________
+
+const int TiledImage::TILE_SIZE;
+
+TiledImage::TiledImage (size_t budget, const string & scratch_dir)
+    : rows(0), cols(0), tile_rows(0), tile_cols(0), budget(budget), dir(scratch_dir) {
+    if (dir.empty()){
+        const char * env = getenv("TMPDIR");
+        dir = env && *env ? env : "/tmp";
+    }
+}
+
+TiledImage::TiledImage (int rows, int cols, size_t budget, const string & scratch_dir)
+    : TiledImage(budget, scratch_dir) {
+    Reset(rows, cols);
+}
+
+TiledImage::~TiledImage () {}
+
+bool TiledImage::Reset (int rows, int cols){
+    cache.reset();
+    this->rows = this->cols = tile_rows = tile_cols = 0;
+    if (rows <= 0 || cols <= 0)
+        return true;
+
+    // Fichero temporal sin nombre: se borra en cuanto se crea y desaparece al cerrarlo
+    const int ntr = (rows + TILE_SIZE - 1) / TILE_SIZE, ntc = (cols + TILE_SIZE - 1) / TILE_SIZE;
+    const size_t ntiles = (size_t)ntr * ntc;
+    string templ = dir + "/tiledImageXXXXXX";
+    int fd = mkstemp(&templ[0]);
+    if (fd >= 0){
+        unlink(templ.c_str());
+        if (ftruncate(fd, (off_t)(ntiles * TILE_BYTES)) != 0){
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0){
+        cache.reset(new Cache(-1, 0, 0));
+        return false;
+    }
+
+    size_t nframes = max(budget / TILE_BYTES, (size_t)GetNumThreads());
+    cache.reset(new Cache(fd, (int)ntiles, min(nframes, ntiles)));
+    IMAGE_PROFILE_ALLOC(cache->frames.size() * TILE_BYTES);
+    this->rows = rows;
+    this->cols = cols;
+    tile_rows = ntr;
+    tile_cols = ntc;
+    return true;
+}
+
+bool TiledImage::Good () const {
+    return !cache || cache->good;
+}
+
+TileCacheStats TiledImage::Stats () const {
+    TileCacheStats s = { 0, 0, 0, 0, 0 };
+    if (cache){
+        lock_guard<mutex> lock(cache->m);
+        s = { cache->hits, cache->misses, cache->reads, cache->writes, cache->frames.size() };
+    }
+    return s;
+}
+
+/*
+ * Llama a fn(tile_row, tile_col, datos) con cada bloque que corta el rectángulo de filas
+ * [r0, r1) y columnas [c0, c1), por filas de bloques, repartiendo los bloques entre los hilos.
+ * Cada hilo pide por adelantado el siguiente bloque de su parte. @a once indica que los
+ * bloques no volverán a usarse pronto.
+ */
+template <class F>
+void TiledImage::ForEachTile (int r0, int c0, int r1, int c1, int mode, bool once, F fn) const {
+    r0 = max(r0, 0);
+    c0 = max(c0, 0);
+    r1 = min(r1, rows);
+    c1 = min(c1, cols);
+    if (r0 >= r1 || c0 >= c1)
+        return;
+
+    const int tr0 = r0 / TILE_SIZE, tc0 = c0 / TILE_SIZE;
+    const int ntr = (r1 - 1) / TILE_SIZE - tr0 + 1, ntc = (c1 - 1) / TILE_SIZE - tc0 + 1;
+    auto tile_at = [&](int k) { return (tr0 + k / ntc) * tile_cols + tc0 + k % ntc; };
+
+    ParallelFor(ntr * ntc, [&](int begin, int end) {
+        for (int k = begin; k < end; ++k){
+            if (k + 1 < end)
+                cache->Prefetch(tile_at(k + 1));
+
+            // Solo se evita leer el bloque si el rectángulo cubre toda su parte útil
+            const int tr = tr0 + k / ntc, tc = tc0 + k % ntc, tile = tile_at(k);
+            int m = mode;
+            if (m == TILE_OVERWRITE && (r0 > tr * TILE_SIZE || c0 > tc * TILE_SIZE
+                                        || r1 < min(rows, (tr + 1) * TILE_SIZE)
+                                        || c1 < min(cols, (tc + 1) * TILE_SIZE)))
+                m = TILE_UPDATE;
+
+            fn(tr, tc, cache->Acquire(tile, m));
+            cache->Release(tile, once);
+        }
+    }, 1);
+}
+
+// _____________________________________________________________________________
+
+bool TiledImage::Load (const char * path){
+    IMAGE_PROFILE_SCOPE("TiledImage::Load");
+    MappedFile file;
+    PNMHeader h;
+    if (!file.Open(path) || !ParsePNMHeader(file.data(), file.size(), h) || h.kind != IMG_PGM
+        || file.size() - h.offset < (size_t)h.rows * h.cols)
+        return false;
+    if (!Reset(h.rows, h.cols))
+        return false;
+    IMAGE_PROFILE_PIXELS((size_t)rows * cols);
+
+    const unsigned char * pixels = file.data() + h.offset;
+    ForEachTile(0, 0, rows, cols, TILE_OVERWRITE, true, [&](int tr, int tc, unsigned char * data) {
+        const int i0 = tr * TILE_SIZE, j0 = tc * TILE_SIZE;
+        const int th = min(TILE_SIZE, rows - i0), tw = min(TILE_SIZE, cols - j0);
+        for (int r = 0; r < th; ++r)
+            memcpy(data + r * TILE_SIZE, pixels + (size_t)(i0 + r) * cols + j0, tw);
+    });
+    return Good();
+}
+
+bool TiledImage::Save (const char * path) const {
+    IMAGE_PROFILE_SCOPE("TiledImage::Save");
+    IMAGE_PROFILE_PIXELS((size_t)rows * cols);
+    if (rows == 0)
+        return false;
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    char header[PGM_HEADER_MAX];
+    off_t pos = FormatPGMHeader(header, rows, cols);
+    bool ok = WriteAt(fd, (const unsigned char *)header, pos, 0);
+
+    // Cada franja de bloques se reúne en memoria y se escribe de una vez
+    vector<unsigned char> band((size_t)TILE_SIZE * cols);
+    for (int tr = 0; ok && tr < tile_rows; ++tr){
+        const int i0 = tr * TILE_SIZE, th = min(TILE_SIZE, rows - i0);
+        ForEachTile(i0, 0, i0 + th, cols, TILE_READ, true, [&](int, int tc, const unsigned char * data) {
+            const int j0 = tc * TILE_SIZE, tw = min(TILE_SIZE, cols - j0);
+            for (int r = 0; r < th; ++r)
+                memcpy(&band[(size_t)r * cols + j0], data + r * TILE_SIZE, tw);
+        });
+        ok = WriteAt(fd, band.data(), (size_t)th * cols, pos);
+        pos += (off_t)th * cols;
+    }
+    return close(fd) == 0 && ok && Good();
+}
+
+// _____________________________________________________________________________
+
+byte TiledImage::get_pixel (int i, int j) const {
+    const int tile = i / TILE_SIZE * tile_cols + j / TILE_SIZE;
+    byte v = cache->Acquire(tile, TILE_READ)[i % TILE_SIZE * TILE_SIZE + j % TILE_SIZE];
+    cache->Release(tile, false);
+    return v;
+}
+
+void TiledImage::set_pixel (int i, int j, byte value){
+    const int tile = i / TILE_SIZE * tile_cols + j / TILE_SIZE;
+    cache->Acquire(tile, TILE_UPDATE)[i % TILE_SIZE * TILE_SIZE + j % TILE_SIZE] = value;
+    cache->Release(tile, false);
+}
+
+void TiledImage::PaintIn (const Image & in, int i, int j){
+    IMAGE_PROFILE_SCOPE("TiledImage::PaintIn");
+    IMAGE_PROFILE_PIXELS(in.size());
+    const int r0 = max(i, 0), c0 = max(j, 0);
+    const int r1 = min(i + in.get_rows(), rows), c1 = min(j + in.get_cols(), cols);
+    ForEachTile(r0, c0, r1, c1, TILE_OVERWRITE, false, [&](int tr, int tc, unsigned char * data) {
+        // Parte del bloque que cae dentro de la región pintada
+        const int a0 = max(r0, tr * TILE_SIZE), a1 = min(r1, (tr + 1) * TILE_SIZE);
+        const int b0 = max(c0, tc * TILE_SIZE), b1 = min(c1, (tc + 1) * TILE_SIZE);
+        for (int r = a0; r < a1; ++r)
+            memcpy(data + (r - tr * TILE_SIZE) * TILE_SIZE + b0 - tc * TILE_SIZE,
+                   in.get_row(r - i) + b0 - j, b1 - b0);
+    });
+}
+
+Image TiledImage::Crop (int nrow, int ncol, int height, int width) const {
+    IMAGE_PROFILE_SCOPE("TiledImage::Crop");
+    IMAGE_PROFILE_PIXELS(height * width);
+    Image res(height, width, 0);
+    ForEachTile(nrow, ncol, nrow + height, ncol + width, TILE_READ, false,
+                [&](int tr, int tc, const unsigned char * data) {
+        const int a0 = max(nrow, tr * TILE_SIZE), a1 = min(min(nrow + height, rows), (tr + 1) * TILE_SIZE);
+        const int b0 = max(ncol, tc * TILE_SIZE), b1 = min(min(ncol + width, cols), (tc + 1) * TILE_SIZE);
+        for (int r = a0; r < a1; ++r)
+            memcpy(res.get_row(r - nrow) + b0 - ncol,
+                   data + (r - tr * TILE_SIZE) * TILE_SIZE + b0 - tc * TILE_SIZE, b1 - b0);
+    });
+    return res;
+}
+
+Image TiledImage::Subsample (int factor, bool partial) const {
+    IMAGE_PROFILE_SCOPE("TiledImage::Subsample");
+    IMAGE_PROFILE_PIXELS((size_t)rows * cols);
+    const int full_rows = rows / factor, full_cols = cols / factor;
+    const int used_rows = partial ? rows : full_rows * factor, used_cols = partial ? cols : full_cols * factor;
+    const int n_rows = (used_rows + factor - 1) / factor, n_cols = (used_cols + factor - 1) / factor;
+    Image icon(n_rows, n_cols);
+    if (icon.Empty())
+        return icon;
+
+    // Columnas del icono que toca cada columna de bloques. Los bloques de una misma fila de
+    // bloques suman en zonas separadas, para que los hilos no escriban en las mismas
+    // posiciones; las columnas del icono compartidas por dos bloques se suman después.
+    vector<int> first_col(tile_cols), n_icon_cols(tile_cols), offset(tile_cols + 1, 0);
+    for (int tc = 0; tc < tile_cols; ++tc){
+        const int j0 = tc * TILE_SIZE, j1 = min(used_cols, j0 + TILE_SIZE);
+        first_col[tc] = j0 / factor;
+        n_icon_cols[tc] = j1 > j0 ? (j1 - 1) / factor - first_col[tc] + 1 : 0;
+        offset[tc + 1] = offset[tc] + n_icon_cols[tc];
+    }
+
+    vector<int> icon_col(used_cols);
+    for (int c = 0; c < used_cols; ++c)
+        icon_col[c] = c / factor;
+
+    // Sumas de las filas del icono que toca cada franja de bloques. La última puede no estar
+    // completa y seguir en la franja siguiente: sus sumas se guardan en carry.
+    vector<unsigned long long> part, sums, carry;
+    int pending = -1;
+    for (int tr = 0; tr * TILE_SIZE < used_rows; ++tr){
+        const int i0 = tr * TILE_SIZE, i1 = min(used_rows, i0 + TILE_SIZE);
+        const int first_row = i0 / factor, band_rows = (i1 - 1) / factor - first_row + 1;
+
+        part.assign((size_t)band_rows * offset[tile_cols], 0);
+        ForEachTile(i0, 0, i1, used_cols, TILE_READ, true, [&](int, int tc, const unsigned char * data) {
+            const int j0 = tc * TILE_SIZE, j1 = min(used_cols, j0 + TILE_SIZE);
+            const int w = n_icon_cols[tc], base = first_col[tc];
+            unsigned long long * acc = &part[(size_t)band_rows * offset[tc]];
+            for (int r = i0; r < i1; ++r){
+                const unsigned char * in = data + (r - i0) * TILE_SIZE;
+                unsigned long long * row = acc + (size_t)(r / factor - first_row) * w;
+                for (int c = j0; c < j1; ++c)
+                    row[icon_col[c] - base] += in[c - j0];
+            }
+        });
+
+        sums.assign((size_t)band_rows * n_cols, 0);
+        if (pending == first_row)
+            copy(carry.begin(), carry.end(), sums.begin());
+        for (int tc = 0; tc < tile_cols; ++tc){
+            const unsigned long long * acc = &part[(size_t)band_rows * offset[tc]];
+            for (int o = 0; o < band_rows; ++o)
+                for (int c = 0; c < n_icon_cols[tc]; ++c)
+                    sums[(size_t)o * n_cols + first_col[tc] + c] += acc[(size_t)o * n_icon_cols[tc] + c];
+        }
+
+        // La media redondeada de cada bloque, como en Image::Subsample
+        pending = -1;
+        for (int o = 0; o < band_rows; ++o){
+            const int io = first_row + o, height = min(factor, used_rows - io * factor);
+            const unsigned long long * s = &sums[(size_t)o * n_cols];
+            if (io * factor + height > i1){
+                pending = io;
+                carry.assign(s, s + n_cols);
+                break;
+            }
+            byte * out = icon.get_row(io);
+            for (int c = 0; c < n_cols; ++c){
+                const unsigned long long area = (unsigned long long)height * min(factor, used_cols - c * factor);
+                out[c] = (byte)((2 * s[c] + area) / (2 * area));
+            }
+        }
+    }
+    return icon;
+}
+
+void TiledImage::AdjustContrast (byte in1, byte in2, byte out1, byte out2){
+    IMAGE_PROFILE_SCOPE("TiledImage::AdjustContrast");
+    IMAGE_PROFILE_PIXELS((size_t)rows * cols);
+
+    // La misma tabla que Image::AdjustContrast, obtenida aplicándolo a los 256 valores
+    Image ramp(1, 256);
+    for (int v = 0; v < 256; ++v)
+        ramp.get_row(0)[v] = (byte)v;
+    ramp.AdjustContrast(in1, in2, out1, out2);
+    const byte * lut = ramp.get_row(0);
+
+    const KernelTable & k = Kernels();
+    ForEachTile(0, 0, rows, cols, TILE_UPDATE, true, [&](int tr, int tc, unsigned char * data) {
+        const int th = min(TILE_SIZE, rows - tr * TILE_SIZE), tw = min(TILE_SIZE, cols - tc * TILE_SIZE);
+        for (int r = 0; r < th; ++r)
+            k.lut(data + r * TILE_SIZE, data + r * TILE_SIZE, tw, lut);
+    });
+}
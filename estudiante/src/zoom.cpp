@@ -7,13 +7,13 @@
 #include <cstdlib>
 
 #include <image.h>
+#include <diskCache.h>
 
 using namespace std;
 
 int main (int argc, char *argv[]){
 
     char *origen, *destino; // nombres de los ficheros
-    Image image;
 
     // Comprobar validez de la llamada
     if (argc != 6){
@@ -31,22 +31,31 @@ int main (int argc, char *argv[]){
     cout << "Fichero origen: " << origen << endl;
     cout << "Fichero resultado: " << destino << endl;
 
-    // Leer la imagen del fichero de entrada
-    if (!image.Load(origen)){
+    // El fichero se lee una sola vez: sirve para buscar el resultado en la cache de resultados y,
+    // si no estaba, para calcularlo
+    int row = atoi(argv[3]), col = atoi(argv[4]), size = atoi(argv[5]);
+    DiskCache cache(DiskCache::DirFromEnvironment());
+    string op = "CropView(" + to_string(row) + "," + to_string(col) + "," + to_string(size) + "," + to_string(size) + ")|Zoom2X()";
+    bool computed = false;
+    Image zoomedImage;
+    auto zoom = [&](const Image & image) {
+        computed = true;
+
+        // Mostrar los parametros de la Imagen
+        cout << endl;
+        cout << "Dimensiones de " << origen << ":" << endl;
+        cout << "   Imagen   = " << image.get_rows()  << " filas x " << image.get_cols() << " columnas " << endl;
+
+        // Hace zoom a la imagen
+        return image.CropView(row, col, size, size).Zoom2X();
+    };
+    if (!cache.Derive(origen, op, zoom, zoomedImage)){
         cerr << "Error: No pudo leerse la imagen." << endl;
         cerr << "Terminando la ejecucion del programa." << endl;
         return 1;
     }
-
-    // Mostrar los parametros de la Imagen
-    cout << endl;
-    cout << "Dimensiones de " << origen << ":" << endl;
-    cout << "   Imagen   = " << image.get_rows()  << " filas x " << image.get_cols() << " columnas " << endl;
-
-    // Hace zoom a la imagen
-    int row = atoi(argv[3]), col = atoi(argv[4]), size = atoi(argv[5]);
-    Image cropped_image = image.Crop(row, col, size, size);
-    Image zoomedImage(cropped_image.Zoom2X());
+    if (!computed)
+        cout << "Resultado tomado de la cache" << endl;
 
     // Guardar la imagen resultado en el fichero
     if (zoomedImage.Save(destino))